@@ -0,0 +1,45 @@
+#include "georgia.h"
+
+// GEORGIA_TTF is the path of the font, set by CMake, which also rebuilds this file when the font changes
+#if defined(_MSC_VER)
+// MSVC has no inline assembler to include a binary with, so CMake writes the bytes out as a const array
+#include "georgia_data.inc"
+#else
+__asm__(
+#if defined(__APPLE__)
+        ".const_data\n"
+        ".globl _georgia_ttf\n"
+        ".p2align 4\n"
+        "_georgia_ttf:\n"
+        ".incbin \"" GEORGIA_TTF "\"\n"
+        "_georgia_ttf_end:\n"
+        ".globl _georgia_ttf_len\n"
+        ".p2align 2\n"
+        "_georgia_ttf_len:\n"
+        ".long _georgia_ttf_end - _georgia_ttf\n"
+        ".text\n"
+#else
+#if defined(_WIN32)
+        ".section .rdata,\"dr\"\n"
+#else
+        ".section .rodata\n"
+        ".type georgia_ttf, @object\n"
+        ".type georgia_ttf_len, @object\n"
+#endif
+        ".globl georgia_ttf\n"
+        ".balign 16\n"
+        "georgia_ttf:\n"
+        ".incbin \"" GEORGIA_TTF "\"\n"
+        "georgia_ttf_end:\n"
+        ".globl georgia_ttf_len\n"
+        ".balign 4\n"
+        "georgia_ttf_len:\n"
+        ".long georgia_ttf_end - georgia_ttf\n"
+#if !defined(_WIN32)
+        ".size georgia_ttf, georgia_ttf_end - georgia_ttf\n"
+        ".size georgia_ttf_len, 4\n"
+#endif
+        ".previous\n"
+#endif
+);
+#endif
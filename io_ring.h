@@ -0,0 +1,217 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define TREECHARTER_IO_URING 1
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Reads whole files in batches through io_uring, talking to the kernel with raw system calls so there is no
+// library to depend on. Every step of a batch (open, size, read, close) is queued for all of its files and
+// handed to the kernel at once, so a batch costs a handful of system calls and keeps every read in flight
+// together. good() is false where io_uring is missing or forbidden, and then nothing else may be called
+class IoRing {
+#if TREECHARTER_IO_URING
+private:
+    int ring = -1;
+    unsigned entries = 0;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    size_t cq_ring_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    template<typename T> static T* at(void* ring_memory, unsigned offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(ring_memory) + offset);
+    }
+    // Queues prepare(i, sqe) for each of the indices and returns each operation's result, a negative errno
+    // for failures
+    template<typename Prepare> std::vector<int> run(const std::vector<size_t>& indices, Prepare prepare) {
+        std::vector<int> results(indices.size(), -ECANCELED);
+        for (size_t begin = 0; begin < indices.size(); begin += entries) {
+            unsigned count = unsigned(std::min<size_t>(entries, indices.size() - begin));
+            unsigned tail = *sq_tail;
+            for (unsigned k = 0; k < count; k++) {
+                unsigned slot = tail & *sq_mask;
+                io_uring_sqe& sqe = sqes[slot];
+                std::memset(&sqe, 0, sizeof(sqe));
+                prepare(indices[begin + k], sqe);
+                sqe.user_data = begin + k;
+                sq_array[slot] = slot;
+                tail++;
+            }
+            __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+            unsigned submitted = 0, completed = 0;
+            while (completed < count) {
+                long entered = syscall(__NR_io_uring_enter, ring, count - submitted, count - completed,
+                                       IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (entered < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    // The ring can't be trusted any more, so the rest of this batch is reported as failed
+                    close(ring);
+                    ring = -1;
+                    return results;
+                }
+                if (entered > 0) submitted += unsigned(entered);
+                unsigned head = *cq_head;
+                unsigned ready = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+                for (; head != ready; head++, completed++) {
+                    const io_uring_cqe& cqe = cqes[head & *cq_mask];
+                    results[cqe.user_data] = cqe.res;
+                }
+                __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            }
+        }
+        return results;
+    }
+public:
+    explicit IoRing(unsigned depth) {
+        io_uring_params params{};
+        ring = int(syscall(__NR_io_uring_setup, depth, &params));
+        if (ring < 0) return;
+        entries = params.sq_entries;
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+                       IORING_OFF_SQ_RING);
+        cq_ring = single ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                          ring, IORING_OFF_CQ_RING);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void* mapped_sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+                                 IORING_OFF_SQES);
+        if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || mapped_sqes == MAP_FAILED) {
+            if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+            if (!single && cq_ring != MAP_FAILED) munmap(cq_ring, cq_ring_size);
+            if (mapped_sqes != MAP_FAILED) munmap(mapped_sqes, sqes_size);
+            sq_ring = cq_ring = nullptr;
+            close(ring);
+            ring = -1;
+            return;
+        }
+        sqes = static_cast<io_uring_sqe*>(mapped_sqes);
+        sq_tail = at<unsigned>(sq_ring, params.sq_off.tail);
+        sq_mask = at<unsigned>(sq_ring, params.sq_off.ring_mask);
+        sq_array = at<unsigned>(sq_ring, params.sq_off.array);
+        cq_head = at<unsigned>(cq_ring, params.cq_off.head);
+        cq_tail = at<unsigned>(cq_ring, params.cq_off.tail);
+        cq_mask = at<unsigned>(cq_ring, params.cq_off.ring_mask);
+        cqes = at<io_uring_cqe>(cq_ring, params.cq_off.cqes);
+    }
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+    ~IoRing() {
+        if (sqes) munmap(sqes, sqes_size);
+        if (cq_ring && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+        if (sq_ring) munmap(sq_ring, sq_ring_size);
+        if (ring >= 0) close(ring);
+    }
+    [[nodiscard]] bool good() const {
+        return ring >= 0;
+    }
+    // Reads each file whole into the matching buffer, leaving it empty when the file can't be read. Kernels
+    // too old for one of the operations answer EINVAL, and that step is done with a plain system call instead
+    void read_files(const std::vector<std::string>& paths, std::vector<std::vector<char>>& contents) {
+        contents.assign(paths.size(), {});
+        std::vector<size_t> all(paths.size());
+        for (size_t i = 0; i < all.size(); i++) all[i] = i;
+        std::vector<int> files = run(all, [&](size_t i, io_uring_sqe& sqe) {
+            sqe.opcode = IORING_OP_OPENAT;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uintptr_t>(paths[i].c_str());
+            sqe.open_flags = O_RDONLY | O_CLOEXEC;
+        });
+        std::vector<size_t> opened;
+        for (size_t i = 0; i < files.size(); i++) {
+            if (files[i] == -EINVAL) files[i] = open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+            if (files[i] >= 0) opened.emplace_back(i);
+        }
+        if (!good()) {
+            for (size_t i: opened) close(files[i]);
+            return;
+        }
+        std::vector<struct statx> stats(paths.size());
+        std::vector<int> statted = run(opened, [&](size_t i, io_uring_sqe& sqe) {
+            sqe.opcode = IORING_OP_STATX;
+            sqe.fd = files[i];
+            sqe.addr = reinterpret_cast<uintptr_t>("");
+            sqe.len = STATX_SIZE;
+            sqe.off = reinterpret_cast<uintptr_t>(&stats[i]);
+            sqe.statx_flags = AT_EMPTY_PATH;
+        });
+        std::vector<size_t> reading, done(paths.size());
+        for (size_t k = 0; k < opened.size(); k++) {
+            size_t i = opened[k];
+            if (statted[k] == -EINVAL) {
+                struct stat fallback{};
+                statted[k] = fstat(files[i], &fallback) == 0 ? 0 : -errno;
+                stats[i].stx_size = uint64_t(fallback.st_size);
+            }
+            if (statted[k] < 0 || stats[i].stx_size == 0) continue;
+            contents[i].resize(size_t(stats[i].stx_size));
+            reading.emplace_back(i);
+        }
+        // Reads can come back short, so whatever is left of each file goes round again
+        while (!reading.empty() && good()) {
+            std::vector<int> got = run(reading, [&](size_t i, io_uring_sqe& sqe) {
+                sqe.opcode = IORING_OP_READ;
+                sqe.fd = files[i];
+                sqe.addr = reinterpret_cast<uintptr_t>(contents[i].data() + done[i]);
+                sqe.len = unsigned(std::min<size_t>(contents[i].size() - done[i], 1u << 30));
+                sqe.off = done[i];
+            });
+            std::vector<size_t> again;
+            for (size_t k = 0; k < reading.size(); k++) {
+                size_t i = reading[k];
+                long result = got[k];
+                if (result == -EINVAL) {
+                    result = pread(files[i], contents[i].data() + done[i], contents[i].size() - done[i], off_t(done[i]));
+                    if (result < 0) result = -errno;
+                }
+                if (result == -EINTR || result == -EAGAIN) again.emplace_back(i);
+                else if (result < 0) contents[i].clear();
+                else if (result == 0) contents[i].resize(done[i]);  // The file shrank while it was read
+                else if ((done[i] += size_t(result)) < contents[i].size()) again.emplace_back(i);
+            }
+            reading.swap(again);
+        }
+        if (!good()) {
+            for (size_t i: opened) close(files[i]);
+            for (std::vector<char>& bytes: contents) bytes.clear();
+            return;
+        }
+        std::vector<int> closed = run(opened, [&](size_t i, io_uring_sqe& sqe) {
+            sqe.opcode = IORING_OP_CLOSE;
+            sqe.fd = files[i];
+        });
+        for (size_t k = 0; k < opened.size(); k++) {
+            if (closed[k] == -EINVAL) close(files[opened[k]]);
+        }
+    }
+#else
+public:
+    explicit IoRing(unsigned) {}
+    [[nodiscard]] bool good() const {
+        return false;
+    }
+    void read_files(const std::vector<std::string>&, std::vector<std::vector<char>>&) {}
+#endif
+};
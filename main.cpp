@@ -1,11 +1,28 @@
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <nlohmann/json.hpp>
 #include <SFML/Graphics.hpp>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 
 #include "georgia.h"
+#include "io_ring.h"
+#include "png.h"
 
 using namespace nlohmann;
 using namespace std;
@@ -15,182 +32,1942 @@ bool panning = false;
 Vector2f screen_pos = {0, 0};
 Vector2f temp_pos = {0, 0};
 float scale = 96;
+float target_scale = 96;
+Vector2f zoom_anchor = {0, 0};
 
-Vector2f position(Vector2f pos) {
-    return scale * pos + screen_pos;
+struct Settings {
+    float min_scale = 0.01;
+    float max_scale = 960;
+    float zoom_step = 1.2;          // Scale factor per notch of the mouse wheel
+    float zoom_speed = 12;          // How quickly the scale eases towards its target, per second
+    float image_threshold = 16;     // Images smaller than this many pixels are not drawn
+    float connector_threshold = 6;  // Connectors are not drawn when nodes are closer than this many pixels
+    float block_threshold = 12;     // Subtrees narrower than this many pixels are drawn as one filled block
+    bool highlight_subtree = false; // Highlight the hovered or focused node's whole subtree, not just its ancestors
+    bool report_latency = false;    // Print how long input takes to reach the screen, once a second
+    bool tile_cache = false;        // Render the chart into cached tiles instead of drawing it every frame
+    unsigned tile_size = 512;
+    float tile_cache_megabytes = 256;
+    unsigned image_uploads_per_frame = 8;  // Decoded images turned into textures each frame
+    float image_cache_megabytes = 512;     // Texture memory for images, beyond what one frame draws
+    float image_margin = 0.5;              // How far around the view images are loaded, in view sizes
+    unsigned image_reads_in_flight = 16;   // Image files read at once, which matters most on network drives
+    float prefetch_seconds = 0.3;          // How far ahead panning is extrapolated to prefetch what it will reveal
+    float flight_seconds = 0.6;     // How long the camera takes to fly to a node found by search, 0 to jump
+    bool minimap = true;            // Show an overview of the whole chart in the bottom right corner
+    Vector2u minimap_size = {320, 160};
+} settings;
+
+const size_t cluster_size = 4096;  // Nodes per cluster of geometry, where the shape of the tree allows
+
+Transform view_transform() {
+    Transform transform;
+    transform.translate(screen_pos);
+    transform.scale(scale, scale);
+    return transform;
+}
+
+FloatRect world_rect(const View& view) {
+    return {(view.getCenter() - view.getSize() / float(2) - screen_pos) / scale, view.getSize() / scale};
+}
+
+int detail_level(float at_scale = scale) {
+    return max(0, int(ceil(log2(settings.block_threshold / at_scale))));
+}
+
+// An animated move of the camera to centre a point of the chart, zooming out on the way when the two ends
+// are too far apart to be seen together
+struct Flight {
+    bool active = false;
+    float elapsed = 0;
+    Vector2f from;  // World points at the centre of the view
+    Vector2f to;
+    float from_scale = 1;
+    float top_scale = 1;  // The scale the flight passes through halfway
+    float to_scale = 1;
+    void start(Vector2f point, const View& view) {
+        from = (view.getCenter() - screen_pos) / scale;
+        to = point;
+        from_scale = scale;
+        to_scale = target_scale;
+        float distance = hypot(to.x - from.x, to.y - from.y);
+        float fit = distance > 0 ? min(view.getSize().x, view.getSize().y) / distance : to_scale;
+        top_scale = min({from_scale, to_scale, fit});
+        elapsed = 0;
+        active = settings.flight_seconds > 0;
+        if (!active) {
+            scale = target_scale = to_scale;
+            screen_pos = view.getCenter() - scale * to;
+        }
+    }
+    // The part of the chart that will be visible once the flight lands
+    [[nodiscard]] FloatRect destination(const View& view) const {
+        Vector2f size = view.getSize() / to_scale;
+        return {to - size / float(2), size};
+    }
+    // Returns whether the view moved
+    bool update(float seconds, const View& view) {
+        if (!active) return false;
+        elapsed += seconds;
+        float t = min(elapsed / settings.flight_seconds, float(1));
+        float eased = t * t * (3 - 2 * t);
+        // A quadratic curve through the logarithms of the scales, so zooming feels even at every depth. Its
+        // control point is placed so that the curve reaches top_scale halfway, and it is a straight line when
+        // there is no need to zoom out further than one of the ends
+        float ends = (log(from_scale) + log(to_scale)) / 2;
+        float control = top_scale < min(from_scale, to_scale) ? 2 * log(top_scale) - ends : ends;
+        float log_scale = (1 - eased) * (1 - eased) * log(from_scale) + 2 * eased * (1 - eased) * control +
+                          eased * eased * log(to_scale);
+        scale = target_scale = t == 1 ? to_scale : exp(log_scale);
+        screen_pos = view.getCenter() - scale * (from + (to - from) * eased);
+        active = t < 1;
+        return true;
+    }
+} flight;
+
+void zoom_by(float notches, Vector2f anchor) {
+    flight.active = false;
+    target_scale = std::clamp(target_scale * pow(settings.zoom_step, notches), settings.min_scale, settings.max_scale);
+    zoom_anchor = anchor;
+}
+
+// Returns whether the view moved
+bool update_zoom(float seconds) {
+    if (scale == target_scale) return false;
+    float new_scale = scale * pow(target_scale / scale, std::min(seconds * settings.zoom_speed, float(1)));
+    if (abs(new_scale / target_scale - 1) < 0.001) new_scale = target_scale;
+    screen_pos = zoom_anchor + (screen_pos - zoom_anchor) * (new_scale / scale);
+    scale = new_scale;
+    return true;
 }
 
 Font georgia;
 
+void add_rect(VertexArray& triangles, Vector2f top_left, Vector2f bottom_right, Color color) {
+    Vertex corners[] = {
+            Vertex(top_left, color),
+            Vertex({bottom_right.x, top_left.y}, color),
+            Vertex(bottom_right, color),
+            Vertex({top_left.x, bottom_right.y}, color)};
+    for (int corner: {0, 1, 2, 0, 2, 3}) triangles.append(corners[corner]);
+}
+
+void add_line(VertexArray& lines, Vector2f from, Vector2f to) {
+    lines.append(Vertex(from, Color::White));
+    lines.append(Vertex(to, Color::White));
+}
+
+FloatRect merge(const FloatRect& a, const FloatRect& b) {
+    if (a.width <= 0 && a.height <= 0) return b;
+    if (b.width <= 0 && b.height <= 0) return a;
+    float left = min(a.left, b.left);
+    float top = min(a.top, b.top);
+    return {left, top, max(a.left + a.width, b.left + b.width) - left, max(a.top + a.height, b.top + b.height) - top};
+}
+
+struct Bits {
+    vector<uint64_t> words;
+    explicit Bits(size_t size = 0) : words((size + 63) / 64) {}
+    [[nodiscard]] bool test(size_t i) const {
+        return words[i / 64] >> (i % 64) & 1;
+    }
+    void set(size_t i) {
+        words[i / 64] |= uint64_t(1) << (i % 64);
+    }
+    [[nodiscard]] size_t count() const {
+        size_t total = 0;
+        for (uint64_t word: words) total += bitset<64>(word).count();
+        return total;
+    }
+};
+
+class Batch : public Drawable {
+private:
+    VertexArray vertices;
+    VertexBuffer buffer;
+    void draw(RenderTarget& target, RenderStates states) const override {
+        if (buffer.getVertexCount() > 0) target.draw(buffer, states);
+        else target.draw(vertices, states);
+    }
+public:
+    explicit Batch(PrimitiveType type) : vertices(type), buffer(type, VertexBuffer::Static) {}
+    VertexArray& staging() {
+        return vertices;
+    }
+    // Moves the staged vertices into video memory, keeping them on the CPU only if vertex buffers are unsupported
+    void upload() {
+        if (!VertexBuffer::isAvailable() || vertices.getVertexCount() == 0) return;
+        if (buffer.create(vertices.getVertexCount()) && buffer.update(&vertices[0]))
+            vertices = VertexArray(vertices.getPrimitiveType());
+    }
+    // Overwrites uploaded vertices starting at offset
+    void patch(size_t offset, const VertexArray& replacement) {
+        if (replacement.getVertexCount() == 0) return;
+        if (buffer.getVertexCount() > 0) buffer.update(&replacement[0], replacement.getVertexCount(), unsigned(offset));
+        else for (size_t v = 0; v < replacement.getVertexCount(); v++) vertices[offset + v] = replacement[v];
+    }
+};
+
+struct Geometry {
+    Batch boxes{Triangles};
+    Batch lines{Lines};
+    FloatRect bounds;   // Relative to the x position of the cluster's root
+    float block_width = 1;  // Subtrees narrower than this are blocks
+    vector<pair<size_t, size_t>> shapes;  // Each drawn node with the first vertex of its box or block, in preorder
+};
+
+// A connected piece of the tree whose geometry is stored relative to its root, so it only has to be
+// rebuilt when the layout inside it changes
+struct Cluster {
+    size_t root = 0;
+    vector<size_t> images;
+    map<int, Geometry> detail;  // Built the first time the cluster is drawn at each level of detail
+};
+
+// Shrinks the image to fit in a square of the given size, averaging every source pixel that falls into
+// each output pixel
+Image shrink(const Image& source, unsigned size) {
+    Vector2u from = source.getSize();
+    float factor = float(size) / float(max(from.x, from.y));
+    Vector2u to(max(unsigned(float(from.x) * factor), 1u), max(unsigned(float(from.y) * factor), 1u));
+    vector<Uint8> pixels(size_t(to.x) * to.y * 4);
+    const Uint8* in = source.getPixelsPtr();
+    for (unsigned y = 0; y < to.y; y++) {
+        unsigned top = y * from.y / to.y, bottom = max((y + 1) * from.y / to.y, top + 1);
+        for (unsigned x = 0; x < to.x; x++) {
+            unsigned left = x * from.x / to.x, right = max((x + 1) * from.x / to.x, left + 1);
+            unsigned sums[4] = {};
+            for (unsigned sy = top; sy < bottom; sy++) {
+                for (unsigned sx = left; sx < right; sx++) {
+                    const Uint8* pixel = in + (size_t(sy) * from.x + sx) * 4;
+                    for (int c = 0; c < 4; c++) sums[c] += pixel[c];
+                }
+            }
+            unsigned count = (bottom - top) * (right - left);
+            for (int c = 0; c < 4; c++) pixels[(size_t(y) * to.x + x) * 4 + c] = Uint8(sums[c] / count);
+        }
+    }
+    Image image;
+    image.create(to.x, to.y, pixels.data());
+    return image;
+}
+
+// Every image the chart uses, loaded once per distinct name however many nodes share it, and only once a
+// node showing it comes near the view, at the smallest thumbnail size that covers how large it is drawn.
+// Thumbnails are kept on disk, keyed by the source file's path and modification time. Files are read and
+// decoded on worker threads, newest requests first, and uploaded to textures a few per frame on the render
+// thread. The least recently drawn textures are freed when they take up more than the budget, and files
+// that fail to load are remembered, so they are not tried again
+class Images {
+private:
+    static constexpr unsigned thumbnail_sizes[] = {64, 128};
+    static constexpr unsigned original = UINT_MAX;
+    enum State { Unloaded, Loading, Ready, Missing };
+    struct Entry {
+        string name;
+        State state = Unloaded;
+        unsigned size = 0;       // Of the loaded texture
+        unsigned requested = 0;  // The largest size asked of the workers
+        bool background = false; // Only asked for by prefetching, which may be called off
+        bool evicted = false;    // Freed for the budget, and loaded again only once it is asked for on screen
+        unique_ptr<Texture> texture;
+        size_t bytes = 0;
+        size_t used_frame = 0;
+        list<uint32_t>::iterator use;  // Valid while Ready
+    };
+    struct Job {
+        uint32_t handle;
+        string name;
+        unsigned size;
+    };
+    struct Read {
+        Job job;
+        string path;             // The file to read, empty when the source is missing
+        string thumbnail;        // The thumbnail of the job's size, empty when the original was asked for
+        bool from_thumbnail = false;
+        vector<char> bytes;      // Empty when the file couldn't be read
+    };
+    struct Result {
+        uint32_t handle;
+        unsigned size;
+        unique_ptr<Image> image;  // Null when the decode failed
+    };
+    vector<Entry> entries;
+    unordered_map<string, uint32_t> handles;
+    list<uint32_t> uses;  // Ready textures, most recently drawn first
+    size_t resident = 0;  // Bytes of texture memory
+    size_t frame = 0;
+    bool uploaded = false;  // This frame
+    mutex lock;  // Guards the queues and stopping
+    condition_variable wake;         // For readers
+    condition_variable wake_decoder;
+    condition_variable idle;
+    vector<Job> queued;
+    vector<Job> background;  // Prefetches, started only when nothing on screen is waiting
+    vector<Read> reads;
+    vector<Result> decoded;
+    size_t busy = 0;         // Jobs being read or decoded
+    bool stopping = false;
+    vector<thread> workers;
+    unique_ptr<IoRing> ring;  // Null where io_uring can't be used, and a pool of blocking readers runs instead
+    // Picks the thumbnail of the job's size if there is one already, and otherwise the source
+    static Read resolve(Job job) {
+        Read read{std::move(job), {}, {}, false, {}};
+        string path = "img/" + read.job.name + ".png";
+        error_code error;
+        auto modified = filesystem::last_write_time(path, error);
+        if (error) return read;
+        read.path = path;
+        if (read.job.size == original) return read;
+        size_t key = hash<string>()(path + "|" + to_string(modified.time_since_epoch().count()));
+        ostringstream thumbnail;
+        thumbnail << "cache/thumbnails/" << hex << key << "-" << dec << read.job.size << ".png";
+        read.thumbnail = thumbnail.str();
+        if (filesystem::exists(read.thumbnail, error)) {
+            read.path = read.thumbnail;
+            read.from_thumbnail = true;
+        }
+        return read;
+    }
+    static vector<char> read_file(const string& path) {
+        vector<char> bytes;
+        ifstream file(path, ios::binary | ios::ate);
+        if (!file.good()) return bytes;
+        bytes.resize(size_t(file.tellg()));
+        file.seekg(0);
+        if (!file.read(bytes.data(), streamsize(bytes.size()))) bytes.clear();
+        return bytes;
+    }
+    static unique_ptr<Image> decode(Read& read) {
+        auto image = make_unique<Image>();
+        bool loaded = !read.bytes.empty() && image->loadFromMemory(read.bytes.data(), read.bytes.size());
+        if (!loaded && read.from_thumbnail) {
+            // A damaged or vanished thumbnail is made again from the source
+            read.from_thumbnail = false;
+            read.bytes = read_file("img/" + read.job.name + ".png");
+            loaded = !read.bytes.empty() && image->loadFromMemory(read.bytes.data(), read.bytes.size());
+        }
+        if (!loaded) return nullptr;
+        if (read.from_thumbnail || read.thumbnail.empty()) return image;
+        if (max(image->getSize().x, image->getSize().y) <= read.job.size) return image;
+        *image = shrink(*image, read.job.size);
+        // Written aside and renamed, so another viewer never reads half a file
+        string part = read.thumbnail + ".part.png";
+        error_code error;
+        if (image->saveToFile(part)) filesystem::rename(part, read.thumbnail, error);
+        return image;
+    }
+    // Reading and decoding are separate stages, so that many reads can wait on a slow disk or network home
+    // directory at once without holding up the decoders, which are limited to the number of cores. With
+    // io_uring, one reader hands whole batches of files to the kernel at a time
+    void work_reading_batches() {
+        unique_lock<mutex> held(lock);
+        while (true) {
+            wake.wait(held, [this] { return stopping || !queued.empty() || !background.empty(); });
+            if (stopping) return;
+            vector<Read> batch;
+            size_t limit = max(settings.image_reads_in_flight, 1u);
+            while (batch.size() < limit && (!queued.empty() || !background.empty())) {
+                // The newest requests are for whatever is on screen now
+                vector<Job>& jobs = queued.empty() ? background : queued;
+                batch.push_back({std::move(jobs.back()), {}, {}, false, {}});
+                jobs.pop_back();
+            }
+            busy += batch.size();
+            held.unlock();
+            vector<string> paths;
+            for (Read& read: batch) {
+                read = resolve(std::move(read.job));
+                paths.emplace_back(read.path);
+            }
+            vector<vector<char>> contents;
+            if (ring->good()) ring->read_files(paths, contents);
+            // A ring that failed part way through is given up on, and files are read one by one from then on
+            if (!ring->good()) {
+                contents.clear();
+                for (const string& path: paths) contents.emplace_back(read_file(path));
+            }
+            for (size_t i = 0; i < batch.size(); i++) batch[i].bytes = std::move(contents[i]);
+            held.lock();
+            move(batch.begin(), batch.end(), back_inserter(reads));
+            wake_decoder.notify_all();
+        }
+    }
+    void work_reading() {
+        unique_lock<mutex> held(lock);
+        while (true) {
+            wake.wait(held, [this] { return stopping || !queued.empty() || !background.empty(); });
+            if (stopping) return;
+            // The newest requests are for whatever is on screen now
+            vector<Job>& jobs = queued.empty() ? background : queued;
+            Job job = std::move(jobs.back());
+            jobs.pop_back();
+            busy++;
+            held.unlock();
+            Read done = resolve(std::move(job));
+            done.bytes = read_file(done.path);
+            held.lock();
+            reads.emplace_back(std::move(done));
+            wake_decoder.notify_one();
+        }
+    }
+    void work_decoding() {
+        unique_lock<mutex> held(lock);
+        while (true) {
+            wake_decoder.wait(held, [this] { return stopping || !reads.empty(); });
+            if (stopping) return;
+            Read job = std::move(reads.back());
+            reads.pop_back();
+            held.unlock();
+            unique_ptr<Image> image = decode(job);
+            held.lock();
+            decoded.push_back({job.job.handle, job.job.size, std::move(image)});
+            busy--;
+            idle.notify_all();
+        }
+    }
+public:
+    static constexpr uint32_t none = UINT32_MAX;
+    Images() = default;
+    Images(const Images&) = delete;
+    Images& operator=(const Images&) = delete;
+    ~Images() {
+        {
+            lock_guard<mutex> held(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        wake_decoder.notify_all();
+        for (thread& worker: workers) worker.join();
+    }
+    uint32_t get(const string& name) {
+        auto [handle, added] = handles.try_emplace(name, uint32_t(entries.size()));
+        if (added) entries.emplace_back().name = name;
+        return handle->second;
+    }
+    // Asks for the image at a size that looks sharp drawn the given number of pixels across. Requests that
+    // aren't urgent wait behind all urgent ones, and those without reload leave images freed for the budget
+    // alone, since loading them would only free something else
+    void request(uint32_t handle, float pixels, bool urgent = true, bool reload = true) {
+        if (handle == none) return;
+        Entry& entry = entries[handle];
+        unsigned size = original;
+        for (unsigned thumbnail: thumbnail_sizes) {
+            if (pixels <= float(thumbnail)) {
+                size = thumbnail;
+                break;
+            }
+        }
+        bool hurry = urgent && entry.background;
+        if (entry.state == Missing || (entry.state != Unloaded && entry.requested >= size && !hurry)) return;
+        if (entry.evicted && !reload) return;
+        entry.evicted = false;
+        if (entry.state == Unloaded) entry.state = Loading;
+        entry.requested = max(entry.requested, size);
+        entry.background = !urgent;
+        lock_guard<mutex> held(lock);
+        if (workers.empty()) {
+            ring = make_unique<IoRing>(max(settings.image_reads_in_flight, 1u));
+            if (ring->good()) workers.emplace_back([this] { work_reading_batches(); });
+            else {
+                ring.reset();
+                for (unsigned i = 0; i < max(settings.image_reads_in_flight, 1u); i++)
+                    workers.emplace_back([this] { work_reading(); });
+            }
+            for (unsigned i = 0; i < max(thread::hardware_concurrency(), 2u) - 1; i++)
+                workers.emplace_back([this] { work_decoding(); });
+        }
+        (urgent ? queued : background).push_back({handle, entry.name, entry.requested});
+        wake.notify_one();
+    }
+    // Calls off prefetches that haven't started, since they were predicted from an older view
+    void cancel_background() {
+        vector<Job> cancelled;
+        {
+            lock_guard<mutex> held(lock);
+            cancelled.swap(background);
+        }
+        for (const Job& job: cancelled) {
+            Entry& entry = entries[job.handle];
+            if (!entry.background) continue;
+            entry.background = false;
+            entry.requested = entry.state == Ready ? entry.size : 0;
+            if (entry.state == Loading) entry.state = Unloaded;
+        }
+    }
+    // Turns at most limit decoded images into textures, and returns the images that were placeholders until
+    // now, which have either arrived or turned out to be missing
+    vector<uint32_t> upload(size_t limit) {
+        vector<uint32_t> settled;
+        vector<Result> batch;
+        {
+            lock_guard<mutex> held(lock);
+            size_t count = min(limit, decoded.size());
+            move(decoded.end() - ptrdiff_t(count), decoded.end(), back_inserter(batch));
+            decoded.resize(decoded.size() - count);
+        }
+        for (Result& result: batch) {
+            Entry& entry = entries[result.handle];
+            // Evicted since it was asked for, or overtaken by a larger size
+            if (entry.state == Unloaded || (entry.state == Ready && entry.size >= result.size)) continue;
+            auto texture = make_unique<Texture>();
+            if (!result.image || !texture->loadFromImage(*result.image)) {
+                if (entry.state != Loading) continue;
+                entry.state = Missing;
+                settled.emplace_back(result.handle);
+                continue;
+            }
+            // Without mipmaps, small icons sample scattered texels of the full image and shimmer as they move
+            bool mipmapped = texture->generateMipmap();
+            texture->setSmooth(true);
+            uploaded = true;
+            if (entry.state == Ready) {
+                resident -= entry.bytes;
+                uses.erase(entry.use);
+            } else settled.emplace_back(result.handle);
+            entry.texture = std::move(texture);
+            entry.state = Ready;
+            entry.size = result.size;
+            entry.bytes = size_t(result.image->getSize().x) * result.image->getSize().y * 4;
+            if (mipmapped) entry.bytes += entry.bytes / 3;
+            entry.used_frame = frame;
+            resident += entry.bytes;
+            uses.emplace_front(result.handle);
+            entry.use = uses.begin();
+        }
+        return settled;
+    }
+    // Waits for every requested image and uploads it, for when nothing can be drawn without them
+    void finish() {
+        {
+            unique_lock<mutex> held(lock);
+            idle.wait(held, [this] { return queued.empty() && background.empty() && busy == 0; });
+        }
+        upload(entries.size());
+    }
+    // Frees the least recently drawn textures over the budget, except those drawn in the frame just ended
+    void end_frame() {
+        auto budget = size_t(settings.image_cache_megabytes * 1024 * 1024);
+        while (resident > budget && !uses.empty() && entries[uses.back()].used_frame != frame) {
+            Entry& entry = entries[uses.back()];
+            entry.texture.reset();
+            entry.state = Unloaded;
+            entry.requested = 0;
+            entry.background = false;
+            entry.evicted = true;
+            resident -= entry.bytes;
+            uses.pop_back();
+        }
+        frame++;
+        uploaded = false;
+    }
+    [[nodiscard]] bool uploaded_this_frame() const {
+        return uploaded;
+    }
+    // Whether the image may still appear
+    [[nodiscard]] bool pending(uint32_t handle) const {
+        return handle != none && (entries[handle].state == Unloaded || entries[handle].state == Loading);
+    }
+    // The texture to draw the image with the given number of pixels across, if it is loaded, marking it as
+    // used this frame. Shrunk images are always filtered from the mipmaps; enlarged ones are filtered only
+    // until each texel covers a few pixels, after which sharp texels look better than a blur
+    const Texture* use(uint32_t handle, float pixels) {
+        if (handle == none || entries[handle].state != Ready) return nullptr;
+        Entry& entry = entries[handle];
+        entry.used_frame = frame;
+        uses.splice(uses.begin(), uses, entry.use);
+        Vector2u size = entry.texture->getSize();
+        entry.texture->setSmooth(pixels < float(3 * max(size.x, size.y)));
+        return entry.texture.get();
+    }
+    // Marks the image as used this frame without drawing it, for images shown through a cached tile
+    void touch(uint32_t handle) {
+        if (handle == none || entries[handle].state != Ready) return;
+        entries[handle].used_frame = frame;
+        uses.splice(uses.begin(), uses, entries[handle].use);
+    }
+} images;
+
 class Icon {
+    friend class Icons;
+    friend class Tooltip;
+    friend class SearchIndex;
+    friend class Filter;
 private:
     string i;
-    string n;
+    string n;           // UTF-8, as searched
     string d;
+    String name_text;   // n and d decoded once, as drawn
+    String description_text;
+    size_t parent = 0;
+    size_t last_child = 0;  // 0 when this node is a leaf
+    size_t previous = 0;    // The sibling before this node, 0 when it is the first child
+    size_t end = 0;         // One past the last node of this subtree
+    size_t cluster = 0;
     float pos = 0;
-    vector<Icon> children;
-    RectangleShape box;
+    float level = 0;
+    float width = 1;        // Leaf slots taken up by this subtree
+    float height = 0;       // Levels below this node
+    bool collapsed = false;
+    bool hidden = false;    // Inside a collapsed subtree, or removed by a filter
+    bool on_path = false;   // Highlighted as an ancestor of the hovered or focused node, or that node itself
+    bool in_subtree = false;
     bool has_img = false;
-    Texture img;
+    uint32_t img = Images::none;
 public:
     Icon() = default;
     Icon(string id, string name, string description, const string& image = "") {
         i = std::move(id);
         n = std::move(name);
         d = std::move(description);
-        box.setFillColor(Color(127, 138, 168));
+        name_text = String::fromUtf8(n.begin(), n.end());
+        description_text = String::fromUtf8(d.begin(), d.end());
         if (!image.empty()) {
-            img.loadFromFile("img/" + image + ".png");
+            img = images.get(image);
             has_img = true;
         }
     }
-    void add_child(const Icon& child) {
-        children.emplace_back(child);
-    }
-    void move_by(float distance) {
-        pos += distance;
-        for (Icon& child: children) child.move_by(distance);
-    }
-    void move_to(float position) {
-        for (Icon& child: children) child.move_by(position - pos);
-        pos = position;
-    }
-    float to_positions() {
-        map<string, float> widths;
-        float width = 0;
-        for (Icon& child: children) {
-            float w = child.to_positions();
-            widths[child.i] = w;
-            width += w;
-        }
-        float used_width = 0;
-        for (Icon& child: children) {
-            child.move_by((widths[child.i] - width) / 2 + used_width);
-            used_width += widths[child.i];
-        }
-        if (width >= 1) {
-            return width;
-        } else return 1;
-    }
-    void draw(RenderWindow& screen, float level = 0) {
-        if (!children.empty()) {
-            float min = children[0].pos + float(1)/3;
-            float max = children[0].pos + float(1)/3;
-            for (Icon child: children) {
-                Vector2f center(child.pos + float(1)/3, level + float(5)/6);
-                Vertex child_line[] = {
-                        Vertex(position(center + Vector2f(0, 0.5)), Color::White),
-                        Vertex(position(center), Color::White)};
-                screen.draw(child_line, 2, Lines);
-                if (center.x < min) min = center.x;
-                if (center.x > max) max = center.x;
-                child.draw(screen, level + 1);
-            }
-            Vector2f center(pos + float(1)/3, level + float(5)/6);
-            Vertex parent_line[] = {
-                    Vertex(position(center - Vector2f(0, 0.5)), Color::White),
-                    Vertex(position(center), Color::White)};
-            screen.draw(parent_line, 2, Lines);
-            if (children.size() > 1) {
-                Vertex cross_line[] = {
-                        Vertex(position(Vector2f(min, center.y)), Color::White),
-                        Vertex(position(Vector2f(max, center.y)), Color::White)};
-                screen.draw(cross_line, 2, Lines);
-            }
-        }
-        float side_length = scale * float(2)/3;
-        box.setSize({side_length, side_length});
-        box.setPosition(position({pos, level}));
-        screen.draw(box);
-        if (has_img) {
-            Sprite s(img);
-            float x_scale = scale * float(8)/15 / s.getLocalBounds().getSize().x;
-            float y_scale = scale * float(8)/15 / s.getLocalBounds().getSize().y;
-            s.setScale({x_scale, y_scale});
-            s.setPosition(position(Vector2f(pos + float(1)/15, level + float(1)/15)));
-            screen.draw(s);
-        }
-    }
-    void draw_overlay(RenderWindow& screen, Vector2f mouse_position, float level = 0) {
-        Vector2f p = position({pos, level});
-        Rect bounds(p.x, p.y, scale * float(2)/3, scale * float(2)/3);
-        if (bounds.contains(mouse_position)) {
-            RectangleShape infobox;
-            infobox.setFillColor(Color(69, 71, 79));
-            infobox.setPosition(mouse_position);
-            Text name, description;
-            name.setFont(georgia);
-            description.setFont(georgia);
-            name.setString(n);
-            description.setString(d);
-            name.setCharacterSize(36);
-            description.setCharacterSize(18);
-            name.setFillColor(Color::White);
-            description.setFillColor(Color::White);
-            name.setStyle(Text::Bold);
-            name.setPosition(mouse_position + Vector2f{12, 12});
-            description.setPosition(mouse_position + Vector2f(12, 24 + name.getLocalBounds().height));
-            if (name.getLocalBounds().width > description.getLocalBounds().width) infobox.setSize(Vector2f(
-                    24 + name.getLocalBounds().width,
-                    36 + name.getLocalBounds().height + description.getLocalBounds().height));
-            else infobox.setSize(Vector2f(
-                    24 + description.getLocalBounds().width,
-                    36 + name.getLocalBounds().height + description.getLocalBounds().height));
-            screen.draw(infobox);
-            screen.draw(name);
-            screen.draw(description);
-        } else for (Icon child: children) child.draw_overlay(screen, mouse_position, level + 1);
-    }
-    static vector<Icon> load_children_of(json data, const string& parent) {
-        vector<Icon> children = {};
-        for (auto it = data.begin(); it != data.end(); it++) {
-            const string& id = it.key();
-            if (data[id]["parent"] == parent) {
-                Icon icon;
-                if (data[id]["image"].is_null()) icon = Icon(id, data[id]["name"], data[id]["description"]);
-                else icon = Icon(id, data[id]["name"], data[id]["description"], data[id]["image"]);
-                for (const Icon& child: load_children_of(data, id)) {
-                    icon.add_child(child);
+    [[nodiscard]] FloatRect bounds() const {
+        return {pos, level, float(2)/3, float(2)/3};
+    }
+    [[nodiscard]] FloatRect subtree_bounds() const {
+        return {pos - (width - 1) / 2, level - float(1)/6, width - float(1)/3, height + float(5)/6};
+    }
+    [[nodiscard]] Color color(bool dim) const {
+        if (on_path) return {222, 178, 92};
+        if (in_subtree) return {158, 176, 222};
+        if (dim) return {62, 66, 78};
+        return collapsed ? Color(96, 104, 128) : Color(127, 138, 168);
+    }
+    void draw(VertexArray& boxes, float origin, bool dim) const {
+        add_rect(boxes, {pos - origin, level}, {pos - origin + float(2)/3, level + float(2)/3}, color(dim));
+    }
+    void draw_collapsed(VertexArray& lines, float origin) const {
+        Vector2f center(pos - origin + float(1)/3, level + float(5)/6);
+        add_line(lines, center - Vector2f(float(1)/12, 0), center + Vector2f(float(1)/12, 0));
+        add_line(lines, center - Vector2f(0, float(1)/12), center + Vector2f(0, float(1)/12));
+    }
+    void draw_block(VertexArray& boxes, float origin, bool dim) const {
+        add_rect(boxes, {pos - origin - (width - 1) / 2, level},
+                 {pos - origin + (width - 1) / 2 + float(2)/3, level + height + float(2)/3}, color(dim));
+    }
+    // Returns whether it drew a placeholder because the image hasn't arrived yet
+    bool draw_image(RenderTarget& screen, const Transform& transform) const {
+        const Texture* texture = images.use(img, transform.transformRect({0, 0, float(8)/15, float(8)/15}).width);
+        if (!texture) {
+            if (!images.pending(img)) return false;
+            RectangleShape placeholder({float(8)/15, float(8)/15});
+            placeholder.setPosition(Vector2f(pos + float(1)/15, level + float(1)/15));
+            placeholder.setFillColor(Color(104, 113, 140));
+            screen.draw(placeholder, transform);
+            return true;
+        }
+        Sprite s(*texture);
+        float x_scale = float(8)/15 / s.getLocalBounds().getSize().x;
+        float y_scale = float(8)/15 / s.getLocalBounds().getSize().y;
+        s.setScale({x_scale, y_scale});
+        s.setPosition(Vector2f(pos + float(1)/15, level + float(1)/15));
+        screen.draw(s, transform);
+        return false;
+    }
+    static Icon load(json& data, const string& id) {
+        if (data[id]["image"].is_null()) return {id, data[id]["name"], data[id]["description"]};
+        else return {id, data[id]["name"], data[id]["description"], data[id]["image"]};
+    }
+};
+
+// The name and description of the hovered node, laid out again only when a different node is hovered
+class Tooltip : public Drawable, public Transformable {
+private:
+    const Icon* icon = nullptr;
+    RectangleShape infobox;
+    Text name, description;
+    vector<pair<Uint32, bool>> cold;  // Characters not rasterised yet, and whether they are for a name
+    void draw(RenderTarget& target, RenderStates states) const override {
+        states.transform *= getTransform();
+        target.draw(infobox, states);
+        target.draw(name, states);
+        target.draw(description, states);
+    }
+public:
+    Tooltip() {
+        infobox.setFillColor(Color(69, 71, 79));
+        name.setFont(georgia);
+        description.setFont(georgia);
+        name.setCharacterSize(36);
+        description.setCharacterSize(18);
+        name.setFillColor(Color::White);
+        description.setFillColor(Color::White);
+        name.setStyle(Text::Bold);
+        name.setPosition({12, 12});
+    }
+    // Finds every character the names and descriptions use, so that warm can rasterise them before the
+    // first tooltip needs them. The most used come first, so that a large alphabet of rare ideographs doesn't
+    // hold up the letters almost every tooltip has
+    void gather(const vector<Icon>& icons) {
+        unordered_map<Uint32, size_t> in_names, in_descriptions;
+        for (const Icon& icon: icons) {
+            for (Uint32 c: icon.name_text) in_names[c]++;
+            for (Uint32 c: icon.description_text) in_descriptions[c]++;
+        }
+        // Text lays out whitespace with the space glyph, so it is needed first whatever the strings hold
+        in_names[' '] = in_descriptions[' '] = SIZE_MAX;
+        vector<tuple<size_t, Uint32, bool>> by_use;
+        for (auto [c, count]: in_names) by_use.emplace_back(count, c, true);
+        for (auto [c, count]: in_descriptions) by_use.emplace_back(count, c, false);
+        // warm takes from the back, so the commonest go last, and of equally common ones the lowest code points
+        sort(by_use.begin(), by_use.end(), [](const auto& a, const auto& b) {
+            return get<0>(a) != get<0>(b) ? get<0>(a) < get<0>(b) : get<1>(a) > get<1>(b);
+        });
+        cold.clear();
+        for (auto [count, c, bold]: by_use) cold.emplace_back(c, bold);
+    }
+    // Rasterises up to count of the gathered characters into the font's glyph pages
+    void warm(size_t count) {
+        for (; count > 0 && !cold.empty(); count--) {
+            auto [c, bold] = cold.back();
+            cold.pop_back();
+            if (bold) georgia.getGlyph(c, name.getCharacterSize(), true);
+            else georgia.getGlyph(c, description.getCharacterSize(), false);
+        }
+    }
+    void show(const Icon* hovered) {
+        if (hovered == icon) return;
+        icon = hovered;
+        if (!icon) return;
+        name.setString(icon->name_text);
+        description.setString(icon->description_text);
+        FloatRect name_bounds = name.getLocalBounds();
+        FloatRect description_bounds = description.getLocalBounds();
+        description.setPosition({12, 24 + name_bounds.height});
+        infobox.setSize({24 + max(name_bounds.width, description_bounds.width),
+                         36 + name_bounds.height + description_bounds.height});
+    }
+};
+
+char fold(char c) {
+    return char(tolower(static_cast<unsigned char>(c)));
+}
+
+// Whether text contains the already folded query, or starts with it
+bool matches(const string& text, const string& folded, bool prefix) {
+    auto same = [](char a, char b) { return fold(a) == b; };
+    if (prefix) return text.size() >= folded.size() && equal(text.begin(), text.begin() + folded.size(),
+                                                             folded.begin(), same);
+    return search(text.begin(), text.end(), folded.begin(), folded.end(), same) != text.end();
+}
+
+// Trigram index over the case-folded names and descriptions. Queries of three or more bytes only check the
+// nodes that contain every one of their trigrams; shorter queries, and queries made before the index is
+// ready, check every node.
+class SearchIndex {
+private:
+    vector<uint32_t> keys;       // Trigrams that occur anywhere, sorted
+    vector<uint32_t> offsets;    // Where each key's nodes start in postings, followed by the end
+    vector<uint32_t> postings;   // Node indices, sorted within each key
+    atomic<bool> ready = false;
+    thread builder;
+    static void trigrams(const string& text, vector<uint32_t>& out) {
+        for (size_t i = 0; i + 3 <= text.size(); i++) {
+            out.emplace_back(uint32_t(uint8_t(fold(text[i]))) << 16 | uint32_t(uint8_t(fold(text[i + 1]))) << 8 |
+                             uint32_t(uint8_t(fold(text[i + 2]))));
+        }
+    }
+    static void trigrams(const Icon& icon, vector<uint32_t>& out) {
+        out.clear();
+        trigrams(icon.n, out);
+        trigrams(icon.d, out);
+        sort(out.begin(), out.end());
+        out.erase(unique(out.begin(), out.end()), out.end());
+    }
+    void index(const vector<Icon>& icons) {
+        vector<uint32_t> counts(1 << 24);
+        vector<uint32_t> grams;
+        for (const Icon& icon: icons) {
+            trigrams(icon, grams);
+            for (uint32_t gram: grams) counts[gram]++;
+        }
+        uint32_t total = 0;
+        for (uint32_t gram = 0; gram < counts.size(); gram++) {
+            if (counts[gram] == 0) continue;
+            keys.emplace_back(gram);
+            offsets.emplace_back(total);
+            total += counts[gram];
+            counts[gram] = uint32_t(keys.size() - 1);
+        }
+        offsets.emplace_back(total);
+        postings.resize(total);
+        vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+        for (uint32_t i = 0; i < icons.size(); i++) {
+            trigrams(icons[i], grams);
+            for (uint32_t gram: grams) postings[next[counts[gram]]++] = i;
+        }
+        ready.store(true, memory_order_release);
+    }
+public:
+    SearchIndex() = default;
+    SearchIndex(const SearchIndex&) = delete;
+    SearchIndex& operator=(const SearchIndex&) = delete;
+    ~SearchIndex() {
+        if (builder.joinable()) builder.join();
+    }
+    // Names and descriptions never change after loading, so the builder can read them while the chart is shown
+    void build(const vector<Icon>& icons) {
+        builder = thread([this, &icons] { index(icons); });
+    }
+    // Finds nodes whose name or description contains the query, or starts with it when the query begins with ^
+    [[nodiscard]] vector<size_t> find(const vector<Icon>& icons, const string& query) const {
+        bool prefix = !query.empty() && query[0] == '^';
+        string folded = query.substr(prefix ? 1 : 0);
+        for (char& c: folded) c = fold(c);
+        vector<size_t> hits;
+        if (folded.empty()) return hits;
+        auto check = [&](size_t i) {
+            if (matches(icons[i].n, folded, prefix) || matches(icons[i].d, folded, prefix)) hits.emplace_back(i);
+        };
+        if (folded.size() < 3 || !ready.load(memory_order_acquire)) {
+            for (size_t i = 0; i < icons.size(); i++) check(i);
+            return hits;
+        }
+        vector<uint32_t> grams;
+        trigrams(folded, grams);
+        sort(grams.begin(), grams.end());
+        grams.erase(unique(grams.begin(), grams.end()), grams.end());
+        vector<pair<uint32_t, uint32_t>> lists;
+        for (uint32_t gram: grams) {
+            auto key = lower_bound(keys.begin(), keys.end(), gram);
+            if (key == keys.end() || *key != gram) return hits;
+            size_t k = key - keys.begin();
+            lists.emplace_back(offsets[k], offsets[k + 1]);
+        }
+        sort(lists.begin(), lists.end(), [](auto a, auto b) { return a.second - a.first < b.second - b.first; });
+        vector<uint32_t> candidates(postings.begin() + lists[0].first, postings.begin() + lists[0].second);
+        for (size_t l = 1; l < lists.size() && !candidates.empty(); l++) {
+            vector<uint32_t> both;
+            set_intersection(candidates.begin(), candidates.end(), postings.begin() + lists[l].first,
+                             postings.begin() + lists[l].second, back_inserter(both));
+            candidates.swap(both);
+        }
+        for (uint32_t i: candidates) check(i);
+        return hits;
+    }
+};
+
+// A predicate over node fields, parsed from queries such as
+//     name contains "Ops" and depth < 4
+//     has image or not (description starts with "Head" or children >= 10)
+class Filter {
+private:
+    enum Kind { All, Any, Not, HasImage, HasChildren, Text, Number };
+    enum Field { Name, Description, Id, Depth, Children };
+    enum Operator { Contains, Starts, Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+    Kind kind = All;
+    Field field = Name;
+    Operator op = Contains;
+    string text;  // Folded
+    float number = 0;
+    vector<Filter> operands;
+    class Parser {
+    private:
+        vector<string> tokens;  // Quoted strings keep their opening quote
+        size_t at = 0;
+        [[nodiscard]] string peek() const {
+            if (at == tokens.size()) return "";
+            string token = tokens[at];
+            if (token[0] != '"') for (char& c: token) c = fold(c);
+            return token;
+        }
+        string next() {
+            if (at == tokens.size()) throw invalid_argument("unexpected end of filter");
+            string token = peek();
+            at++;
+            return token;
+        }
+        void expect(const string& token) {
+            if (next() != token) throw invalid_argument("expected " + token);
+        }
+        Filter any() {
+            Filter first = all();
+            if (peek() != "or") return first;
+            Filter filter;
+            filter.kind = Any;
+            filter.operands.emplace_back(std::move(first));
+            while (peek() == "or") {
+                next();
+                filter.operands.emplace_back(all());
+            }
+            return filter;
+        }
+        Filter all() {
+            Filter first = unary();
+            if (peek() != "and") return first;
+            Filter filter;
+            filter.operands.emplace_back(std::move(first));
+            while (peek() == "and") {
+                next();
+                filter.operands.emplace_back(unary());
+            }
+            return filter;
+        }
+        Filter unary() {
+            string token = next();
+            if (token == "not") {
+                Filter filter;
+                filter.kind = Not;
+                filter.operands.emplace_back(unary());
+                return filter;
+            }
+            if (token == "(") {
+                Filter filter = any();
+                expect(")");
+                return filter;
+            }
+            Filter filter;
+            if (token == "has") {
+                string what = next();
+                if (what == "image") filter.kind = HasImage;
+                else if (what == "children") filter.kind = HasChildren;
+                else throw invalid_argument("unknown property " + what);
+                return filter;
+            }
+            if (token == "name") filter.field = Name;
+            else if (token == "description") filter.field = Description;
+            else if (token == "id") filter.field = Id;
+            else if (token == "depth") filter.field = Depth;
+            else if (token == "children") filter.field = Children;
+            else throw invalid_argument("unknown field " + token);
+            filter.kind = filter.field == Depth || filter.field == Children ? Number : Text;
+            string op = next();
+            if (op == "contains" && filter.kind == Text) filter.op = Contains;
+            else if (op == "starts" && filter.kind == Text) {
+                filter.op = Starts;
+                if (peek() == "with") next();
+            } else if (op == "=") filter.op = Equal;
+            else if (op == "!=") filter.op = NotEqual;
+            else if (op == "<" && filter.kind == Number) filter.op = Less;
+            else if (op == "<=" && filter.kind == Number) filter.op = LessEqual;
+            else if (op == ">" && filter.kind == Number) filter.op = Greater;
+            else if (op == ">=" && filter.kind == Number) filter.op = GreaterEqual;
+            else throw invalid_argument("can't use " + op + " on " + token);
+            string value = next();
+            if (value[0] == '"') value.erase(0, 1);
+            if (filter.kind == Text) {
+                filter.text = value;
+                return filter;
+            }
+            try {
+                filter.number = stof(value);
+            } catch (const logic_error&) {
+                throw invalid_argument(value + " is not a number");
+            }
+            return filter;
+        }
+    public:
+        explicit Parser(const string& query) {
+            for (size_t i = 0; i < query.size();) {
+                char c = query[i];
+                if (isspace(static_cast<unsigned char>(c))) i++;
+                else if (c == '"') {
+                    size_t close = query.find('"', i + 1);
+                    if (close == string::npos) throw invalid_argument("unclosed quote");
+                    tokens.emplace_back(query.substr(i, close - i));
+                    i = close + 1;
+                } else if (c == '(' || c == ')') {
+                    tokens.emplace_back(1, c);
+                    i++;
+                } else if (c == '<' || c == '>' || c == '=' || c == '!') {
+                    size_t length = i + 1 < query.size() && query[i + 1] == '=' ? 2 : 1;
+                    tokens.emplace_back(query.substr(i, length));
+                    i += length;
+                } else {
+                    size_t start = i;
+                    while (i < query.size() && !isspace(static_cast<unsigned char>(query[i])) &&
+                           string("()<>=!\"").find(query[i]) == string::npos) i++;
+                    tokens.emplace_back(query.substr(start, i - start));
+                }
+            }
+        }
+        Filter parse() {
+            Filter filter = any();
+            if (at != tokens.size()) throw invalid_argument("unexpected " + tokens[at]);
+            return filter;
+        }
+    };
+    template<typename T> [[nodiscard]] bool compare(T value, T target) const {
+        switch (op) {
+            case Equal: return value == target;
+            case NotEqual: return value != target;
+            case Less: return value < target;
+            case LessEqual: return value <= target;
+            case Greater: return value > target;
+            case GreaterEqual: return value >= target;
+            default: return false;
+        }
+    }
+public:
+    // Throws invalid_argument describing the first problem in the query
+    static Filter parse(const string& query) {
+        Filter filter = Parser(query).parse();
+        filter.fold_text();
+        return filter;
+    }
+    void fold_text() {
+        for (char& c: text) c = fold(c);
+        for (Filter& operand: operands) operand.fold_text();
+    }
+    [[nodiscard]] bool accepts(const vector<Icon>& icons, size_t i) const {
+        const Icon& icon = icons[i];
+        switch (kind) {
+            case All:
+                for (const Filter& operand: operands) if (!operand.accepts(icons, i)) return false;
+                return true;
+            case Any:
+                for (const Filter& operand: operands) if (operand.accepts(icons, i)) return true;
+                return false;
+            case Not:
+                return !operands[0].accepts(icons, i);
+            case HasImage:
+                return icon.has_img;
+            case HasChildren:
+                return icon.last_child != 0;
+            case Text: {
+                const string& value = field == Name ? icon.n : field == Description ? icon.d : icon.i;
+                if (op == Contains || op == Starts) return matches(value, text, op == Starts);
+                bool same = value.size() == text.size() && matches(value, text, true);
+                return op == Equal ? same : !same;
+            }
+            case Number: {
+                float value = icon.level;
+                if (field == Children) {
+                    value = 0;
+                    for (size_t child = i + 1; child < icon.end; child = icons[child].end) value++;
+                }
+                return compare(value, number);
+            }
+        }
+        return false;
+    }
+};
+
+// Square pieces of the chart rendered at the current zoom and reused while panning, least recently used first out
+class Tiles {
+private:
+    struct Tile {
+        unique_ptr<RenderTexture> texture;
+        list<pair<int, int>>::iterator use;
+        vector<uint32_t> images;  // Drawn into it, and kept loaded while it is shown
+    };
+    float tiles_scale = 0;
+    map<pair<int, int>, Tile> tiles;
+    list<pair<int, int>> uses;  // Most recently used first
+    static constexpr size_t spare_limit = 4;
+    vector<unique_ptr<RenderTexture>> spare;  // A few textures of dropped tiles, kept to save recreating them
+    vector<pair<uint32_t, FloatRect>> placeholders;  // Images drawn as placeholders into tiles, and where
+    Tile* rendering = nullptr;
+    unique_ptr<RenderTexture> take() {
+        if (!spare.empty()) {
+            unique_ptr<RenderTexture> texture = std::move(spare.back());
+            spare.pop_back();
+            return texture;
+        }
+        auto texture = make_unique<RenderTexture>();
+        texture->create(settings.tile_size, settings.tile_size);
+        return texture;
+    }
+    void retire(unique_ptr<RenderTexture> texture) {
+        if (spare.size() < spare_limit) spare.emplace_back(std::move(texture));
+    }
+    void evict() {
+        auto tile = tiles.find(uses.back());
+        retire(std::move(tile->second.texture));
+        tiles.erase(tile);
+        uses.pop_back();
+    }
+public:
+    void clear() {
+        for (auto& [key, tile]: tiles) retire(std::move(tile.texture));
+        tiles.clear();
+        uses.clear();
+        placeholders.clear();
+    }
+    // Frees every texture, for when the cache is turned off
+    void release() {
+        clear();
+        spare.clear();
+    }
+    void drew_image(uint32_t image) {
+        if (rendering) rendering->images.emplace_back(image);
+    }
+    void drew_placeholder(uint32_t image, const FloatRect& bounds) {
+        placeholders.emplace_back(image, bounds);
+    }
+    // Drops the tiles overlapping the world rectangle
+    void invalidate(const FloatRect& bounds) {
+        if (tiles.empty()) return;
+        float size = float(settings.tile_size) / tiles_scale;  // In world units
+        int left = int(floor(bounds.left / size)), top = int(floor(bounds.top / size));
+        int right = int(floor((bounds.left + bounds.width) / size));
+        int bottom = int(floor((bounds.top + bounds.height) / size));
+        for (int y = top; y <= bottom; y++) {
+            for (int x = left; x <= right; x++) {
+                auto tile = tiles.find({x, y});
+                if (tile == tiles.end()) continue;
+                retire(std::move(tile->second.texture));
+                uses.erase(tile->second.use);
+                tiles.erase(tile);
+            }
+        }
+    }
+    // Drops the tiles that show a placeholder for any of the images, which are sorted
+    void settled(const vector<uint32_t>& settled_images) {
+        if (settled_images.empty() || placeholders.empty()) return;
+        auto kept = remove_if(placeholders.begin(), placeholders.end(), [&](const pair<uint32_t, FloatRect>& shown) {
+            if (!binary_search(settled_images.begin(), settled_images.end(), shown.first)) return false;
+            invalidate(shown.second);
+            return true;
+        });
+        placeholders.erase(kept, placeholders.end());
+    }
+    // render draws the world rectangle it is given into a target through the given transform
+    void draw(RenderTarget& screen, const function<void(RenderTarget&, const Transform&, const FloatRect&)>& render) {
+        if (tiles_scale != scale) {
+            clear();
+            tiles_scale = scale;
+        }
+        float size = float(settings.tile_size);
+        Vector2f offset(round(screen_pos.x), round(screen_pos.y));
+        const View& view = screen.getView();
+        Vector2f top_left = view.getCenter() - view.getSize() / float(2) - offset;
+        int left = int(floor(top_left.x / size)), top = int(floor(top_left.y / size));
+        int right = int(floor((top_left.x + view.getSize().x) / size));
+        int bottom = int(floor((top_left.y + view.getSize().y) / size));
+        size_t budget = size_t(settings.tile_cache_megabytes * 1024 * 1024 / (size * size * 4));
+        budget = max(budget, size_t(right - left + 1) * size_t(bottom - top + 1));
+        for (int y = top; y <= bottom; y++) {
+            for (int x = left; x <= right; x++) {
+                auto [tile, added] = tiles.try_emplace({x, y});
+                if (added) {
+                    if (tiles.size() > budget) evict();
+                    tile->second.texture = take();
+                    RenderTexture& texture = *tile->second.texture;
+                    texture.clear();
+                    Transform transform;
+                    transform.translate(-Vector2f(float(x), float(y)) * size);
+                    transform.scale(scale, scale);
+                    rendering = &tile->second;
+                    render(texture, transform, {Vector2f(float(x), float(y)) * size / scale, Vector2f(size, size) / scale});
+                    rendering = nullptr;
+                    texture.display();
+                    uses.emplace_front(x, y);
+                } else {
+                    uses.splice(uses.begin(), uses, tile->second.use);
+                    for (uint32_t image: tile->second.images) images.touch(image);
                 }
-                children.emplace_back(icon);
+                tile->second.use = uses.begin();
+                Sprite sprite(tile->second.texture->getTexture());
+                sprite.setPosition(Vector2f(float(x), float(y)) * size + offset);
+                screen.draw(sprite);
             }
         }
-        return children;
     }
 };
 
 class Icons {
 private:
-    Icon root;
+    vector<Icon> icons;  // In preorder, so every subtree is a contiguous range starting at its root
+    vector<Cluster> clusters;
+    SearchIndex index;
+    vector<vector<size_t>> rows;  // Nodes on each level, sorted by x
+    Vector2i mouse = {0, 0};
+    bool mouse_inside = false;
+    const Icon* hovered = nullptr;
+    bool hover_changed = true;    // The cursor, the view or the layout has moved since hovered was found
+    size_t focused = 0;
+    bool focus_shown = false;  // The focus is only drawn once the keyboard has been used to move it
+    size_t highlighted = 0;    // icons.size() when nothing is highlighted
+    bool highlighted_subtree = false;
+    bool filtering = false;
+    bool hide_unmatched = false;
+    Bits matched;              // Nodes accepted by the filter
+    Bits kept;                 // Matched nodes and their ancestors, which stay in the layout when hiding the rest
+    [[nodiscard]] bool dimmed(size_t i) const {
+        return filtering && !matched.test(i);
+    }
+    [[nodiscard]] bool filtered_out(size_t i) const {
+        return filtering && hide_unmatched && !kept.test(i);
+    }
+    Tooltip tooltip;
+    size_t revision = 0;  // Changes whenever the layout or the colours of the chart do
+    Tiles tiles;
+    bool drawing_tiles = false;  // Placeholders drawn now are remembered, to redraw their tiles on arrival
+    bool worked = false;         // Geometry or a tile was built this frame, which leaves no time to warm glyphs
+    void build_clusters() {
+        clusters.clear();
+        vector<size_t> sizes(icons.size(), 1);
+        for (size_t i = icons.size(); i-- > 1;) {
+            if (sizes[i] >= cluster_size) sizes[i] = 0;
+            else sizes[icons[i].parent] += sizes[i];
+        }
+        for (size_t i = 0; i < icons.size(); i++) {
+            if (i == 0 || sizes[i] == 0) {
+                icons[i].cluster = clusters.size();
+                clusters.emplace_back().root = i;
+            } else icons[i].cluster = icons[icons[i].parent].cluster;
+            if (icons[i].has_img) clusters[icons[i].cluster].images.emplace_back(i);
+        }
+    }
+    void build(Geometry& geometry, const Cluster& cluster, float block_width) const {
+        float origin = icons[cluster.root].pos;
+        VertexArray& boxes = geometry.boxes.staging();
+        VertexArray& lines = geometry.lines.staging();
+        for (size_t i = cluster.root; i < icons[cluster.root].end;) {
+            const Icon& icon = icons[i];
+            if (icon.cluster != icons[cluster.root].cluster || icon.hidden) {
+                i = icon.end;
+                continue;
+            }
+            Vector2f center(icon.pos - origin + float(1)/3, icon.level + float(5)/6);
+            if (i != 0) add_line(lines, center - Vector2f(0, 1), center - Vector2f(0, float(1)/2));
+            geometry.shapes.emplace_back(i, boxes.getVertexCount());
+            if (icon.width < block_width) {
+                icon.draw_block(boxes, origin, dimmed(i));
+                i = icon.end;
+                continue;
+            }
+            if (icon.collapsed) {
+                icon.draw(boxes, origin, dimmed(i));
+                icon.draw_collapsed(lines, origin);
+                i = icon.end;
+                continue;
+            }
+            size_t first = 0, last = 0;
+            for (size_t child = i + 1; child < icon.end; child = icons[child].end) {
+                if (icons[child].hidden) continue;
+                if (first == 0) first = child;
+                last = child;
+            }
+            if (first != 0) {
+                add_line(lines, center - Vector2f(0, 0.5), center);
+                if (first != last) add_line(lines,
+                        {icons[first].pos - origin + float(1)/3, center.y},
+                        {icons[last].pos - origin + float(1)/3, center.y});
+            }
+            icon.draw(boxes, origin, dimmed(i));
+            i++;
+        }
+        geometry.block_width = block_width;
+        geometry.bounds = merge(boxes.getBounds(), lines.getBounds());
+        geometry.boxes.upload();
+        geometry.lines.upload();
+    }
+    // Redraws the boxes of the cluster's nodes in [first, last) into every geometry already built for it. Nodes
+    // of one cluster are emitted in preorder, so a range of nodes is one range of vertices.
+    void repaint(Cluster& cluster, size_t first, size_t last) {
+        float origin = icons[cluster.root].pos;
+        for (auto& [detail, geometry]: cluster.detail) {
+            auto begin = lower_bound(geometry.shapes.begin(), geometry.shapes.end(), make_pair(first, size_t(0)));
+            auto end = lower_bound(begin, geometry.shapes.end(), make_pair(last, size_t(0)));
+            if (begin == end) continue;
+            VertexArray replacement(Triangles);
+            for (auto shape = begin; shape != end; shape++) {
+                const Icon& icon = icons[shape->first];
+                if (icon.width < geometry.block_width) icon.draw_block(replacement, origin, dimmed(shape->first));
+                else icon.draw(replacement, origin, dimmed(shape->first));
+            }
+            geometry.boxes.patch(begin->second, replacement);
+        }
+    }
+    // The path costs O(depth) and the subtree O(its size); only the vertices of the affected boxes are rewritten,
+    // and only the tiles showing them are dropped
+    void mark(size_t target, bool on, bool subtree) {
+        float block_width = exp2(float(detail_level()));
+        for (size_t j = target;; j = icons[j].parent) {
+            icons[j].on_path = on;
+            repaint(clusters[icons[j].cluster], j, j + 1);
+            tiles.invalidate(icons[j].width < block_width ? icons[j].subtree_bounds() : icons[j].bounds());
+            if (j == 0) break;
+        }
+        if (!subtree) return;
+        size_t end = icons[target].end;
+        tiles.invalidate(icons[target].subtree_bounds());
+        for (size_t i = target + 1; i < end; i++) icons[i].in_subtree = on;
+        repaint(clusters[icons[target].cluster], target + 1, end);
+        auto cluster = upper_bound(clusters.begin(), clusters.end(), target, [](size_t i, const Cluster& c) {
+            return i < c.root;
+        });
+        for (; cluster != clusters.end() && cluster->root < end; cluster++)
+            repaint(*cluster, cluster->root, icons[cluster->root].end);
+    }
+    void highlight(size_t target) {
+        if (target == highlighted && settings.highlight_subtree == highlighted_subtree) return;
+        if (highlighted != icons.size()) mark(highlighted, false, highlighted_subtree);
+        highlighted = target;
+        highlighted_subtree = settings.highlight_subtree;
+        if (highlighted != icons.size()) mark(highlighted, true, highlighted_subtree);
+    }
+    void build_rows() {
+        rows.assign(size_t(icons[0].height) + 1, {});
+        for (size_t i = 0; i < icons.size(); i++) {
+            if (!icons[i].hidden) rows[size_t(icons[i].level)].emplace_back(i);
+        }
+    }
+    [[nodiscard]] const Icon* icon_at(Vector2f mouse_position) const {
+        Vector2f p = (mouse_position - screen_pos) / scale;
+        if (p.y < 0 || p.y >= float(rows.size())) return nullptr;
+        const vector<size_t>& row = rows[size_t(p.y)];
+        auto after = upper_bound(row.begin(), row.end(), p.x, [this](float x, size_t i) {
+            return x < icons[i].pos;
+        });
+        if (after == row.begin()) return nullptr;
+        const Icon& icon = icons[*prev(after)];
+        return icon.bounds().contains(p) ? &icon : nullptr;
+    }
 public:
     explicit Icons(json data) {
-        if (data["root"]["image"].is_null()) root = Icon("root", data["root"]["name"], data["root"]["description"]);
-        else root = Icon("root", data["root"]["name"], data["root"]["description"], data["root"]["image"]);
-        for (const Icon& child: Icon::load_children_of(data, "root")) root.add_child(child);
-        root.move_to(0);
+        map<string, vector<string>> children;
+        for (auto it = data.begin(); it != data.end(); it++) {
+            auto parent = it.value().find("parent");
+            if (it.key() != "root" && parent != it.value().end() && parent->is_string())
+                children[parent->get<string>()].emplace_back(it.key());
+        }
+        vector<pair<string, size_t>> order;
+        vector<pair<string, size_t>> stack = {{"root", 0}};
+        while (!stack.empty()) {
+            auto [id, parent] = stack.back();
+            stack.pop_back();
+            auto found = children.find(id);
+            if (found != children.end()) {
+                for (auto child = found->second.rbegin(); child != found->second.rend(); child++)
+                    stack.emplace_back(*child, order.size());
+            }
+            order.emplace_back(id, parent);
+        }
+        icons.reserve(order.size());
+        for (auto& [id, parent]: order) {
+            icons.emplace_back(Icon::load(data, id));
+            icons.back().parent = parent;
+        }
+        for (size_t i = 1; i < icons.size(); i++) {
+            icons[i].level = icons[icons[i].parent].level + 1;
+            icons[i].previous = icons[icons[i].parent].last_child;
+            icons[icons[i].parent].last_child = i;
+        }
+        for (size_t i = 0; i < icons.size(); i++) icons[i].end = i + 1;
+        highlighted = icons.size();
+        for (size_t i = icons.size(); i-- > 1;) {
+            Icon& parent = icons[icons[i].parent];
+            parent.end = max(parent.end, icons[i].end);
+        }
+        tooltip.gather(icons);
+    }
+    // Nodes inside collapsed subtrees are still laid out relative to each other, so their clusters' geometry
+    // stays valid while they are hidden
+    void layout() {
+        revision++;
+        for (Icon& icon: icons) {
+            icon.width = 0;
+            icon.height = 0;
+        }
+        for (size_t i = icons.size(); i-- > 0;) {
+            Icon& icon = icons[i];
+            if (icon.width < 1) icon.width = 1;
+            if (i == 0) break;
+            Icon& parent = icons[icon.parent];
+            if (parent.collapsed || filtered_out(i)) continue;
+            parent.width += icon.width;
+            parent.height = max(parent.height, icon.height + 1);
+        }
+        for (size_t i = 1; i < icons.size(); i++) {
+            const Icon& parent = icons[icons[i].parent];
+            icons[i].hidden = parent.hidden || parent.collapsed || filtered_out(i);
+        }
+        icons[0].pos = 0;
+        for (size_t i = 0; i < icons.size(); i++) {
+            if (icons[i].last_child == 0) continue;
+            float used_width = 0;
+            for (size_t child = i + 1; child < icons[i].end; child = icons[child].end) {
+                icons[child].pos = icons[i].pos + (icons[child].width - icons[i].width) / 2 + used_width;
+                if (!filtered_out(child)) used_width += icons[child].width;
+            }
+        }
+    }
+    void clear_geometry() {
+        for (Cluster& cluster: clusters) cluster.detail.clear();
+        tiles.clear();
+        revision++;
     }
     void set_positions() {
-        root.to_positions();
-        root.move_to(0);
+        layout();
+        build_clusters();
+        build_rows();
+        hover_changed = true;
+    }
+    // Only the clusters holding the node and its ancestors change shape; the rest of the chart just shifts
+    void relayout_around(size_t i) {
+        layout();
+        build_rows();
+        for (size_t j = i;; j = icons[j].parent) {
+            clusters[icons[j].cluster].detail.clear();
+            if (j == 0) break;
+        }
+        tiles.clear();
+        hover_changed = true;
+    }
+    void toggle(size_t i) {
+        if (icons[i].last_child == 0) return;
+        icons[i].collapsed = !icons[i].collapsed;
+        relayout_around(i);
+    }
+    // Expands every collapsed ancestor of the node, so that it is shown
+    void reveal(size_t i) {
+        if (!icons[i].hidden) return;
+        for (size_t j = icons[i].parent;; j = icons[j].parent) {
+            icons[j].collapsed = false;
+            if (j == 0) break;
+        }
+        relayout_around(i);
+    }
+    void jump_to(size_t i, const View& view) {
+        reveal(i);
+        focused = i;
+        flight.start({icons[i].pos + float(1)/3, icons[i].level + float(1)/3}, view);
+        hover_changed = true;
+    }
+    // Every move follows a stored link, so it takes the same time on a node with 100k children or at the
+    // bottom of a long chain. Only nodes a filter hides are stepped over, like search skips them
+    void move_focus(Keyboard::Key key, const View& view) {
+        while (icons[focused].hidden) focused = icons[focused].parent;
+        const Icon& icon = icons[focused];
+        size_t next = focused;
+        if (key == Keyboard::Up && focused != 0) next = icon.parent;
+        else if (key == Keyboard::Down && icon.last_child != 0) {
+            size_t child = focused + 1;
+            while (child < icon.end && filtered_out(child)) child = icons[child].end;
+            if (child < icon.end) {
+                if (icon.collapsed) toggle(focused);
+                next = child;
+            }
+        } else if (key == Keyboard::Left) {
+            size_t sibling = icon.previous;
+            while (sibling != 0 && filtered_out(sibling)) sibling = icons[sibling].previous;
+            if (sibling != 0) next = sibling;
+        } else if (key == Keyboard::Right && focused != 0) {
+            size_t sibling = icon.end;
+            while (sibling < icons[icon.parent].end && filtered_out(sibling)) sibling = icons[sibling].end;
+            if (sibling < icons[icon.parent].end) next = sibling;
+        }
+        focused = next;
+        focus_shown = true;
+        FloatRect inner = world_rect(view);
+        inner = {inner.left + 1, inner.top + 1, inner.width - 2, inner.height - 2};
+        if (!inner.contains(icons[focused].pos, icons[focused].level) ||
+            !inner.contains(icons[focused].pos + float(2)/3, icons[focused].level + float(2)/3))
+            jump_to(focused, view);
+    }
+    // The first press only shows the focus, so nothing is toggled that the user can't see is focused
+    void toggle_focused() {
+        while (icons[focused].hidden) focused = icons[focused].parent;
+        if (!focus_shown) {
+            focus_shown = true;
+            return;
+        }
+        toggle(focused);
+    }
+    void build_index() {
+        index.build(icons);
+    }
+    [[nodiscard]] vector<size_t> find(const string& query) const {
+        vector<size_t> hits = index.find(icons, query);
+        hits.erase(remove_if(hits.begin(), hits.end(), [this](size_t i) { return filtered_out(i); }), hits.end());
+        return hits;
+    }
+    // Evaluates the filter over chunks of whole bitset words in parallel, and returns the number of matches
+    size_t filter(const Filter& condition, bool hide) {
+        Bits result(icons.size());
+        size_t words = result.words.size();
+        size_t workers = max(thread::hardware_concurrency(), 1u);
+        size_t chunk = (words + workers - 1) / workers;
+        vector<thread> threads;
+        for (size_t begin = 0; begin < words; begin += chunk) {
+            threads.emplace_back([&, begin] {
+                size_t last = min(words, begin + chunk) * 64;
+                for (size_t i = begin * 64; i < min(last, icons.size()); i++) {
+                    if (condition.accepts(icons, i)) result.set(i);
+                }
+            });
+        }
+        for (thread& worker: threads) worker.join();
+        matched = std::move(result);
+        kept = matched;
+        kept.set(0);
+        for (size_t i = icons.size(); i-- > 1;) {
+            if (kept.test(i)) kept.set(icons[i].parent);
+        }
+        filtering = true;
+        hide_unmatched = hide;
+        layout();
+        build_rows();
+        clear_geometry();
+        hover_changed = true;
+        return matched.count();
+    }
+    void clear_filter() {
+        if (!filtering) return;
+        filtering = false;
+        layout();
+        build_rows();
+        clear_geometry();
+        hover_changed = true;
+    }
+    [[nodiscard]] bool is_filtering() const {
+        return filtering;
+    }
+    void toggle_at(Vector2f mouse_position) {
+        const Icon* icon = icon_at(mouse_position);
+        if (icon) toggle(size_t(icon - icons.data()));
+    }
+    // Shows the given number of levels, or every level when it is 0
+    void collapse_to_depth(int depth) {
+        for (Icon& icon: icons) icon.collapsed = depth > 0 && icon.last_child != 0 && icon.level >= float(depth - 1);
+        layout();
+        build_rows();
+        clear_geometry();
+        hover_changed = true;
+    }
+    void move_mouse(Vector2i pixel) {
+        mouse = pixel;
+        mouse_inside = true;
+        hover_changed = true;
+    }
+    void leave_mouse() {
+        mouse_inside = false;
+        hover_changed = true;
+    }
+    void move_view() {
+        hover_changed = true;
+    }
+    [[nodiscard]] const Icon* hovered_icon() const {
+        return hovered;
+    }
+    // at_scale picks the level of detail, for targets drawn at a different scale from the screen
+    void draw_chart(RenderTarget& target, const Transform& view, const FloatRect& visible, float at_scale = scale) {
+        int detail = detail_level(at_scale);
+        float block_width = exp2(float(detail));
+        vector<tuple<const Cluster*, const Geometry*, Transform>> shown;
+        for (Cluster& cluster: clusters) {
+            const Icon& root = icons[cluster.root];
+            if (root.hidden || (cluster.root != 0 && icons[root.parent].width < block_width)) continue;
+            if (!root.subtree_bounds().intersects(visible)) continue;
+            auto [geometry, built] = cluster.detail.try_emplace(detail);
+            if (built) {
+                build(geometry->second, cluster, block_width);
+                worked = true;
+            }
+            FloatRect bounds = geometry->second.bounds;
+            bounds.left += root.pos;
+            if (!bounds.intersects(visible)) continue;
+            Transform transform = view;
+            transform.translate(root.pos, 0);
+            shown.emplace_back(&cluster, &geometry->second, transform);
+        }
+        if (at_scale >= settings.connector_threshold)
+            for (auto& [cluster, geometry, transform]: shown) target.draw(geometry->lines, transform);
+        for (auto& [cluster, geometry, transform]: shown) target.draw(geometry->boxes, transform);
+        if (at_scale * float(8)/15 >= settings.image_threshold) {
+            for (auto& shown_cluster: shown) {
+                for (size_t i: get<0>(shown_cluster)->images) {
+                    if (icons[i].hidden || icons[i].width < block_width || !icons[i].bounds().intersects(visible))
+                        continue;
+                    bool placeholder = icons[i].draw_image(target, view);
+                    if (!drawing_tiles) continue;
+                    tiles.drew_image(icons[i].img);
+                    if (placeholder) tiles.drew_placeholder(icons[i].img, icons[i].bounds());
+                }
+            }
+        }
+    }
+    // Builds the geometry a view of the given part of the chart will need, a few clusters per call so that
+    // the frames spent flying towards it stay smooth
+    void prefetch(const FloatRect& visible, float at_scale, size_t budget) {
+        int detail = detail_level(at_scale);
+        float block_width = exp2(float(detail));
+        for (Cluster& cluster: clusters) {
+            if (budget == 0) return;
+            const Icon& root = icons[cluster.root];
+            if (root.hidden || (cluster.root != 0 && icons[root.parent].width < block_width)) continue;
+            if (!root.subtree_bounds().intersects(visible)) continue;
+            auto [geometry, built] = cluster.detail.try_emplace(detail);
+            if (!built) continue;
+            build(geometry->second, cluster, block_width);
+            worked = true;
+            budget--;
+        }
+    }
+    [[nodiscard]] size_t layout_revision() const {
+        return revision;
+    }
+    [[nodiscard]] FloatRect bounds() const {
+        FloatRect bounds = icons[0].subtree_bounds();
+        return {bounds.left - float(1)/6, bounds.top, bounds.width + float(1)/3, bounds.height + float(1)/6};
+    }
+    // Asks for the images of nodes in the area that are large enough at the scale to be drawn
+    void request_images(const FloatRect& area, float at_scale, bool urgent = true, bool reload = true) const {
+        if (at_scale * float(8)/15 < settings.image_threshold) return;
+        float block_width = exp2(float(detail_level(at_scale)));
+        for (const Cluster& cluster: clusters) {
+            if (cluster.images.empty() || !icons[cluster.root].subtree_bounds().intersects(area)) continue;
+            for (size_t i: cluster.images) {
+                if (!icons[i].hidden && icons[i].width >= block_width && icons[i].bounds().intersects(area))
+                    images.request(icons[i].img, at_scale * float(8)/15, urgent, reload);
+            }
+        }
+    }
+    // Tiles drawn before an image arrived show its placeholder, and only those are drawn again
+    void images_settled(vector<uint32_t> settled) {
+        sort(settled.begin(), settled.end());
+        tiles.settled(settled);
+    }
+    void toggle_tiles() {
+        settings.tile_cache = !settings.tile_cache;
+        if (settings.tile_cache) tiles.clear();
+        else tiles.release();
+    }
+    void toggle_subtree_highlight() {
+        settings.highlight_subtree = !settings.highlight_subtree;
     }
-    void draw(RenderWindow& screen, Vector2f mouse_position) {
-        root.draw(screen);
-        root.draw_overlay(screen, mouse_position);
+    void draw(RenderWindow& screen) {
+        if (hover_changed) {
+            hovered = mouse_inside ? icon_at(screen.mapPixelToCoords(mouse)) : nullptr;
+            hover_changed = false;
+        }
+        if (hovered) highlight(size_t(hovered - icons.data()));
+        else highlight(focus_shown && !icons[focused].hidden ? focused : icons.size());
+        // While a zoom is easing in or a flight is under way, every frame has a new scale and tiles would never
+        // be reused
+        if (settings.tile_cache && scale == target_scale && !flight.active) {
+            drawing_tiles = true;
+            tiles.draw(screen, [this](RenderTarget& target, const Transform& view, const FloatRect& visible) {
+                draw_chart(target, view, visible);
+                worked = true;
+            });
+            drawing_tiles = false;
+        } else draw_chart(screen, view_transform(), world_rect(screen.getView()));
+        if (focus_shown && !icons[focused].hidden) {
+            RectangleShape outline({scale * float(2)/3, scale * float(2)/3});
+            outline.setPosition(scale * Vector2f(icons[focused].pos, icons[focused].level) + screen_pos);
+            outline.setFillColor(Color::Transparent);
+            outline.setOutlineColor(Color(255, 214, 102));
+            outline.setOutlineThickness(3);
+            screen.draw(outline);
+        }
+        tooltip.show(hovered);
+        if (hovered) {
+            tooltip.setPosition(screen.mapPixelToCoords(mouse));
+            screen.draw(tooltip);
+        }
+        // A few glyphs on frames that did nothing else, so rasterising a large alphabet never adds to a busy frame
+        // or shows up as a spike of its own
+        if (!worked && !images.uploaded_this_frame()) tooltip.warm(64);
+        worked = false;
+    }
+};
+
+// A one-line prompt in the top left corner of the view
+class TextBox : public Drawable {
+private:
+    RectangleShape background;
+    Text text;
+    string label;
+    void draw(RenderTarget& target, RenderStates states) const override {
+        target.draw(background, states);
+        target.draw(text, states);
+    }
+public:
+    bool open = false;
+    string query;  // UTF-8
+    explicit TextBox(string label) : label(std::move(label)) {
+        background.setFillColor(Color(69, 71, 79));
+        text.setFont(georgia);
+        text.setCharacterSize(18);
+        text.setFillColor(Color::White);
+    }
+    void show(const string& status) {
+        string shown = label + query + status;
+        text.setString(String::fromUtf8(shown.begin(), shown.end()));
+        FloatRect bounds = text.getLocalBounds();
+        background.setSize({max(bounds.width, float(240)) + 24, bounds.height + 24});
+    }
+    void place(const View& view) {
+        Vector2f corner = view.getCenter() - view.getSize() / float(2) + Vector2f(12, 12);
+        background.setPosition(corner);
+        text.setPosition(corner + Vector2f(12, 12 - text.getLocalBounds().top));
+    }
+    // Returns whether the query changed
+    bool append(Uint32 character) {
+        if (character < 32 || character == 127) return false;
+        basic_string<Uint8> bytes = String(character).toUtf8();
+        query.append(bytes.begin(), bytes.end());
+        return true;
+    }
+    bool erase() {
+        if (query.empty()) return false;
+        while ((static_cast<unsigned char>(query.back()) & 0xc0) == 0x80) query.pop_back();
+        query.pop_back();
+        return true;
+    }
+};
+
+class SearchBox : public TextBox {
+private:
+    void show_hit(Icons& icons, const View& view) {
+        if (!hits.empty()) icons.jump_to(hits[current], view);
+        update();
+    }
+public:
+    vector<size_t> hits;
+    size_t current = 0;
+    SearchBox() : TextBox("Find: ") {}
+    void update() {
+        show(query.empty() ? "" : hits.empty() ? "  (no matches)" :
+             "  (" + to_string(current + 1) + " of " + to_string(hits.size()) + ")");
+    }
+    void run(Icons& icons, const View& view) {
+        hits = icons.find(query);
+        current = 0;
+        show_hit(icons, view);
+    }
+    void step(int direction, Icons& icons, const View& view) {
+        if (hits.empty()) return;
+        current = (current + hits.size() + direction) % hits.size();
+        show_hit(icons, view);
     }
 };
 
+class FilterBox : public TextBox {
+private:
+    string result;
+public:
+    bool hide = false;  // Hide unmatched nodes instead of dimming them
+    FilterBox() : TextBox("Filter: ") {}
+    void update() {
+        show(string("  [") + (hide ? "hide" : "dim") + "]" + result);
+    }
+    void apply(Icons& icons) {
+        result.clear();
+        if (query.empty()) icons.clear_filter();
+        else {
+            try {
+                Clock clock;
+                size_t count = icons.filter(Filter::parse(query), hide);
+                result = "  (" + to_string(count) + " matches in " + to_string(clock.getElapsedTime().asMilliseconds()) + " ms)";
+            } catch (const invalid_argument& error) {
+                result = string("  (") + error.what() + ")";
+            }
+        }
+        update();
+    }
+    void switch_mode(Icons& icons) {
+        hide = !hide;
+        if (icons.is_filtering()) apply(icons);
+        else update();
+    }
+};
+
+// The whole chart, rendered into a small texture whenever the layout changes, with the visible part outlined
+class Minimap : public Drawable {
+private:
+    RenderTexture texture;
+    Sprite sprite;
+    RectangleShape frame;
+    RectangleShape viewport;
+    FloatRect bounds;     // In world units
+    float map_scale = 0;  // Pixels per node
+    size_t revision = 0;
+    bool rendered = false;
+    void draw(RenderTarget& target, RenderStates states) const override {
+        target.draw(frame, states);
+        target.draw(sprite, states);
+        target.draw(viewport, states);
+    }
+public:
+    Minimap() {
+        frame.setFillColor(Color(24, 26, 32, 224));
+        frame.setOutlineColor(Color(69, 71, 79));
+        frame.setOutlineThickness(1);
+        viewport.setFillColor(Color(255, 255, 255, 24));
+        viewport.setOutlineColor(Color(255, 214, 102));
+        viewport.setOutlineThickness(1);
+    }
+    void refresh(Icons& icons) {
+        if (rendered && revision == icons.layout_revision()) return;
+        bounds = icons.bounds();
+        Vector2f limit(settings.minimap_size);
+        map_scale = min(limit.x / bounds.width, limit.y / bounds.height);
+        Vector2u size(max(unsigned(ceil(bounds.width * map_scale)), 1u), max(unsigned(ceil(bounds.height * map_scale)), 1u));
+        if (texture.getSize() != size) texture.create(size.x, size.y);
+        Transform transform;
+        transform.scale(map_scale, map_scale);
+        transform.translate(-bounds.left, -bounds.top);
+        texture.clear(Color::Transparent);
+        icons.draw_chart(texture, transform, bounds, map_scale);
+        texture.display();
+        sprite.setTexture(texture.getTexture(), true);
+        frame.setSize(Vector2f(size));
+        revision = icons.layout_revision();
+        rendered = true;
+    }
+    void place(const View& view) {
+        Vector2f corner = view.getCenter() + view.getSize() / float(2) - frame.getSize() - Vector2f(12, 12);
+        frame.setPosition(corner);
+        sprite.setPosition(corner);
+        FloatRect visible = world_rect(view);
+        FloatRect shown;
+        if (!visible.intersects(bounds, shown)) shown = {bounds.left, bounds.top, 0, 0};
+        viewport.setPosition(corner + (Vector2f(shown.left, shown.top) - Vector2f(bounds.left, bounds.top)) * map_scale);
+        viewport.setSize(Vector2f(shown.width, shown.height) * map_scale);
+    }
+    [[nodiscard]] bool contains(Vector2f point) const {
+        return frame.getGlobalBounds().contains(point);
+    }
+    // Centres the view on the part of the chart under the point
+    void jump(Vector2f point, Vector2f view_center) const {
+        flight.active = false;
+        Vector2f world = (point - frame.getPosition()) / map_scale + Vector2f(bounds.left, bounds.top);
+        screen_pos = view_center - scale * world;
+    }
+};
+
+// Renders the whole chart offscreen in strips of tiles and streams each finished strip into the PNG, so memory
+// stays bounded by one strip however large the image is
+int export_chart(Icons& icons, const string& path, float pixels_per_node) {
+    scale = target_scale = pixels_per_node;
+    FloatRect bounds = icons.bounds();
+    if (ceil(bounds.width * scale) > float(UINT_MAX) || ceil(bounds.height * scale) > float(UINT_MAX)) {
+        cout << "The image would be too large, try fewer pixels per node\n";
+        return 1;
+    }
+    auto width = unsigned(ceil(bounds.width * scale));
+    auto height = unsigned(ceil(bounds.height * scale));
+    unsigned tile_width = min(Texture::getMaximumSize(), 4096u);
+    unsigned strip_height = 32;
+    RenderTexture tile;
+    if (!tile.create(tile_width, strip_height)) {
+        cout << "Couldn't create an offscreen render target\n";
+        return 1;
+    }
+    PngWriter png(path, width, height);
+    if (!png.good()) {
+        cout << "Couldn't write to " << path << "\n";
+        return 1;
+    }
+    cout << "Exporting " << width << "x" << height << " image to " << path << "...\n";
+    vector<Uint8> strip(size_t(width) * strip_height * 3);
+    for (unsigned top = 0; top < height; top += strip_height) {
+        unsigned rows = min(strip_height, height - top);
+        // Images are loaded a strip at a time, so the image budget holds for exports of any size
+        icons.request_images({bounds.left, bounds.top + float(top) / scale, bounds.width, float(strip_height) / scale},
+                             scale);
+        images.finish();
+        for (unsigned left = 0; left < width; left += tile_width) {
+            unsigned columns = min(tile_width, width - left);
+            Transform transform;
+            transform.translate(-float(left), -float(top));
+            transform.scale(scale, scale);
+            transform.translate(-bounds.left, -bounds.top);
+            tile.clear();
+            icons.draw_chart(tile, transform, {bounds.left + float(left) / scale, bounds.top + float(top) / scale,
+                                               float(tile_width) / scale, float(strip_height) / scale});
+            tile.display();
+            Image image = tile.getTexture().copyToImage();
+            const Uint8* pixels = image.getPixelsPtr();
+            for (unsigned y = 0; y < rows; y++) {
+                for (unsigned x = 0; x < columns; x++) {
+                    const Uint8* pixel = pixels + (size_t(y) * tile_width + x) * 4;
+                    Uint8* out = strip.data() + (size_t(y) * width + left + x) * 3;
+                    out[0] = pixel[0];
+                    out[1] = pixel[1];
+                    out[2] = pixel[2];
+                }
+            }
+        }
+        for (unsigned y = 0; y < rows; y++) png.write_row(strip.data() + size_t(y) * width * 3);
+        images.end_frame();
+    }
+    png.finish();
+    if (!png.good()) {
+        cout << "Couldn't write to " << path << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+void load_settings() {
+    ifstream reader("settings.json");
+    if (!reader.good()) return;
+    json data = json::parse(reader);
+    settings.min_scale = data.value("min_scale", settings.min_scale);
+    settings.max_scale = data.value("max_scale", settings.max_scale);
+    settings.zoom_step = data.value("zoom_step", settings.zoom_step);
+    settings.zoom_speed = data.value("zoom_speed", settings.zoom_speed);
+    settings.image_threshold = data.value("image_threshold", settings.image_threshold);
+    settings.connector_threshold = data.value("connector_threshold", settings.connector_threshold);
+    settings.block_threshold = data.value("block_threshold", settings.block_threshold);
+    settings.highlight_subtree = data.value("highlight_subtree", settings.highlight_subtree);
+    settings.report_latency = data.value("report_latency", settings.report_latency);
+    settings.tile_cache = data.value("tile_cache", settings.tile_cache);
+    settings.tile_size = data.value("tile_size", settings.tile_size);
+    settings.tile_cache_megabytes = data.value("tile_cache_megabytes", settings.tile_cache_megabytes);
+    settings.image_uploads_per_frame = data.value("image_uploads_per_frame", settings.image_uploads_per_frame);
+    settings.image_cache_megabytes = data.value("image_cache_megabytes", settings.image_cache_megabytes);
+    settings.image_margin = data.value("image_margin", settings.image_margin);
+    settings.prefetch_seconds = data.value("prefetch_seconds", settings.prefetch_seconds);
+    settings.image_reads_in_flight = data.value("image_reads_in_flight", settings.image_reads_in_flight);
+    settings.flight_seconds = data.value("flight_seconds", settings.flight_seconds);
+    settings.minimap = data.value("minimap", settings.minimap);
+    if (data.contains("minimap_size"))
+        settings.minimap_size = {data["minimap_size"][0].get<unsigned>(), data["minimap_size"][1].get<unsigned>()};
+}
+
 void setup() {
     if (!filesystem::exists("charts/")) filesystem::create_directories("charts/");
     if (!filesystem::exists("img/")) filesystem::create_directories("img/");
+    if (!filesystem::exists("cache/thumbnails/")) filesystem::create_directories("cache/thumbnails/");
+    load_settings();
 }
 
-int main() {
-    setup();
-    georgia.loadFromMemory(georgia_ttf, georgia_ttf_len);
-    cout << "Tree Chart Name: ";
-    string file_name;
-    cin >> file_name;
+// Time from polling a frame's first input event to presenting that frame
+class LatencyMeter {
+private:
+    Clock clock;
+    float input = 0;
+    bool waiting = false;
+    float total = 0;
+    float worst = 0;
+    int frames = 0;
+    float reported = 0;
+public:
+    void saw_input() {
+        if (waiting) return;
+        input = clock.getElapsedTime().asSeconds();
+        waiting = true;
+    }
+    void presented() {
+        if (!waiting) return;
+        waiting = false;
+        float now = clock.getElapsedTime().asSeconds();
+        total += now - input;
+        worst = max(worst, now - input);
+        frames++;
+        if (now - reported < 1) return;
+        cout << "Input latency: " << 1000 * total / float(frames) << " ms average, " << 1000 * worst
+             << " ms worst over " << frames << " frames\n";
+        total = worst = 0;
+        frames = 0;
+        reported = now;
+    }
+};
 
+json load_chart(const string& file_name) {
     json data = {};
     ifstream reader("charts/" + file_name + ".json");
     if (reader.good()) {
@@ -201,22 +1978,85 @@ int main() {
         data["root"]["name"] = "Root";
         data["root"]["description"] = "Welcome to Tree Charter";
     }
-    Icons icons(data);
+    return data;
+}
+
+int main(int argc, char* argv[]) {
+    setup();
+    georgia.loadFromMemory(georgia_ttf, georgia_ttf_len);
+    vector<string> args(argv + 1, argv + argc);
+    if (!args.empty() && args[0] == "--export") {
+        float pixels_per_node = 96;
+        size_t parsed = 0;
+        if (args.size() > 3) {
+            try {
+                pixels_per_node = stof(args[3], &parsed);
+            } catch (const logic_error&) {
+                pixels_per_node = 0;
+            }
+        }
+        bool valid = args.size() <= 3 || (parsed == args[3].size() && isfinite(pixels_per_node) && pixels_per_node > 0);
+        if (args.size() < 3 || !valid) {
+            cout << "Usage: TreeCharter --export <chart name> <output.png> [pixels per node]\n";
+            return 1;
+        }
+        Icons icons(load_chart(args[1]));
+        icons.set_positions();
+        return export_chart(icons, args[2], pixels_per_node);
+    }
+    cout << "Tree Chart Name: ";
+    string file_name;
+    cin >> file_name;
+
+    Icons icons(load_chart(file_name));
     icons.set_positions();
     RenderWindow screen{{1200, 800}, "Tree Charter"};
     View view = screen.getDefaultView();
     bool fullscreen = false;
     screen_pos = Vector2f(screen.getSize() / unsigned(2));
+    icons.build_index();
+    SearchBox search;
+    FilterBox filter;
+    Minimap minimap;
+    LatencyMeter latency;
+    Clock frame_clock;
+    Vector2f pan_velocity;  // Pixels per second, smoothed over a few frames
     while (screen.isOpen()) {
         screen.clear();
+        Vector2f panned_from = screen_pos;
+        // Motion is gathered over the whole frame and applied once, from the coordinates in the events
+        bool moved = false;
+        Vector2i moved_to;
         for (auto event = Event{}; screen.pollEvent(event);) {
+            if (event.type != Event::Closed && event.type != Event::Resized && event.type != Event::LostFocus &&
+                event.type != Event::GainedFocus) latency.saw_input();
             if (event.type == Event::Closed) {
                 screen.close();
             } else if (event.type == Event::Resized) {
                 view.setSize({static_cast<float>(event.size.width), static_cast<float>(event.size.height)});
                 screen.setView(view);
+                icons.move_view();
+            } else if (event.type == Event::KeyPressed && search.open) {
+                if (event.key.code == Keyboard::Escape) search.open = false;
+                else if (event.key.code == Keyboard::Enter) search.step(event.key.shift ? -1 : 1, icons, screen.getView());
+                else if (event.key.code == Keyboard::Backspace && search.erase()) search.run(icons, screen.getView());
+            } else if (event.type == Event::TextEntered && search.open) {
+                if (search.append(event.text.unicode)) search.run(icons, screen.getView());
+            } else if (event.type == Event::KeyPressed && filter.open) {
+                if (event.key.code == Keyboard::Escape) filter.open = false;
+                else if (event.key.code == Keyboard::Enter) filter.apply(icons);
+                else if (event.key.code == Keyboard::Tab) filter.switch_mode(icons);
+                else if (event.key.code == Keyboard::Backspace && filter.erase()) filter.update();
+            } else if (event.type == Event::TextEntered && filter.open) {
+                if (filter.append(event.text.unicode)) filter.update();
             } else if (event.type == Event::KeyPressed) {
-                if (Keyboard::isKeyPressed(Keyboard::F11)) {
+                if (event.key.code == Keyboard::F && event.key.control && event.key.shift) {
+                    filter.open = true;
+                    filter.update();
+                } else if (event.key.code == Keyboard::F && event.key.control) {
+                    search.open = true;
+                    search.update();
+                } else if (event.key.code == Keyboard::F11) {
                     if (fullscreen) {
                         screen.create({
                             static_cast<unsigned int>(view.getSize().x),
@@ -230,19 +2070,102 @@ int main() {
                             }, "Tree Charter", Style::Fullscreen);
                         fullscreen = true;
                     }
-                } else if (Keyboard::isKeyPressed(Keyboard::Space)) screen_pos = Vector2f(screen.getSize() / unsigned(2));
+                    icons.move_view();
+                } else if (event.key.code >= Keyboard::Num0 && event.key.code <= Keyboard::Num9) {
+                    icons.collapse_to_depth(event.key.code - Keyboard::Num0);
+                } else if (event.key.code == Keyboard::Up || event.key.code == Keyboard::Down ||
+                           event.key.code == Keyboard::Left || event.key.code == Keyboard::Right) {
+                    icons.move_focus(event.key.code, screen.getView());
+                } else if (event.key.code == Keyboard::Enter) {
+                    icons.toggle_focused();
+                } else if (event.key.code == Keyboard::H) {
+                    icons.toggle_subtree_highlight();
+                } else if (event.key.code == Keyboard::T) {
+                    icons.toggle_tiles();
+                } else if (event.key.code == Keyboard::M) {
+                    settings.minimap = !settings.minimap;
+                } else if (event.key.code == Keyboard::Space) {
+                    screen_pos = Vector2f(screen.getSize() / unsigned(2));
+                    scale = target_scale = 96;
+                    flight.active = false;
+                    icons.move_view();
+                }
+            } else if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Left &&
+                       settings.minimap && minimap.contains(screen.mapPixelToCoords({event.mouseButton.x, event.mouseButton.y}))) {
+                minimap.jump(screen.mapPixelToCoords({event.mouseButton.x, event.mouseButton.y}), screen.getView().getCenter());
+                icons.move_view();
+            } else if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Left) {
+                icons.toggle_at(screen.mapPixelToCoords({event.mouseButton.x, event.mouseButton.y}));
             } else if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Right) {
                 panning = true;
-                temp_pos = Vector2f(Mouse::getPosition());
+                flight.active = false;
+                temp_pos = Vector2f(Vector2i(event.mouseButton.x, event.mouseButton.y));
             } else if (event.type == Event::MouseButtonReleased && event.mouseButton.button == Mouse::Right) {
+                if (panning) screen_pos += Vector2f(Vector2i(event.mouseButton.x, event.mouseButton.y)) - temp_pos;
                 panning = false;
-            } else if (event.type == Event::MouseMoved and panning) {
-                screen_pos += Vector2f(Mouse::getPosition()) - temp_pos;
-                temp_pos = Vector2f(Mouse::getPosition());
+            } else if (event.type == Event::MouseMoved) {
+                moved = true;
+                moved_to = {event.mouseMove.x, event.mouseMove.y};
+            } else if (event.type == Event::MouseLeft) {
+                icons.leave_mouse();
+            } else if (event.type == Event::MouseWheelScrolled && event.mouseWheelScroll.wheel == Mouse::VerticalWheel) {
+                zoom_by(event.mouseWheelScroll.delta, screen.mapPixelToCoords(
+                        {event.mouseWheelScroll.x, event.mouseWheelScroll.y}));
+            }
+        }
+        if (moved) {
+            if (panning) {
+                screen_pos += Vector2f(moved_to) - temp_pos;
+                temp_pos = Vector2f(moved_to);
             }
+            icons.move_mouse(moved_to);
+        }
+        float seconds = frame_clock.restart().asSeconds();
+        if (!panning) pan_velocity = {0, 0};
+        else if (seconds > 0)
+            pan_velocity += ((screen_pos - panned_from) / seconds - pan_velocity) * min(seconds * 10, float(1));
+        if (flight.update(seconds, screen.getView())) icons.move_view();
+        if (update_zoom(seconds)) icons.move_view();
+        FloatRect visible = world_rect(screen.getView());
+        float margin = settings.image_margin;
+        // Only images on screen are loaded again after being freed for the budget, or a margin holding more
+        // than the budget would load and free the same images every frame
+        icons.request_images(visible, scale);
+        icons.request_images({visible.left - visible.width * margin, visible.top - visible.height * margin,
+                              visible.width * (1 + 2 * margin), visible.height * (1 + 2 * margin)}, scale, true, false);
+        images.cancel_background();
+        if (pan_velocity != Vector2f(0, 0)) {
+            // Where the view will be if the drag carries on as it is going
+            FloatRect ahead = visible;
+            ahead.left -= pan_velocity.x * settings.prefetch_seconds / scale;
+            ahead.top -= pan_velocity.y * settings.prefetch_seconds / scale;
+            icons.request_images(ahead, scale, false, false);
+            icons.prefetch(ahead, scale, 2);
+        }
+        if (flight.active) {
+            // The landing view's images are on screen within the flight's duration, so they are urgent too
+            FloatRect destination = flight.destination(screen.getView());
+            icons.request_images(destination, flight.to_scale, true, false);
+            icons.prefetch(destination, flight.to_scale, 4);
+        }
+        icons.images_settled(images.upload(settings.image_uploads_per_frame));
+        icons.draw(screen);
+        if (settings.minimap) {
+            minimap.refresh(icons);
+            minimap.place(screen.getView());
+            screen.draw(minimap);
+        }
+        if (search.open) {
+            search.place(screen.getView());
+            screen.draw(search);
+        }
+        if (filter.open) {
+            filter.place(screen.getView());
+            screen.draw(filter);
         }
-        icons.draw(screen, Vector2f(Mouse::getPosition(screen)));
         screen.display();
+        images.end_frame();
+        if (settings.report_latency) latency.presented();
     }
     return 0;
 }
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// Writes an 8-bit RGB PNG one row at a time, compressing as it goes, so that only the current row and
+// a small output buffer are ever held in memory
+class PngWriter {
+private:
+    std::ofstream file;
+    z_stream stream{};
+    std::vector<unsigned char> buffer = std::vector<unsigned char>(1 << 16);
+    std::vector<unsigned char> row;
+    unsigned width;
+    unsigned height;
+    unsigned rows = 0;
+    static void put_u32(unsigned char* out, uLong value) {
+        out[0] = (value >> 24) & 0xff;
+        out[1] = (value >> 16) & 0xff;
+        out[2] = (value >> 8) & 0xff;
+        out[3] = value & 0xff;
+    }
+    void chunk(const char* type, const unsigned char* data, size_t size) {
+        unsigned char header[8];
+        put_u32(header, size);
+        std::memcpy(header + 4, type, 4);
+        uLong crc = crc32(0, header + 4, 4);
+        if (size > 0) crc = crc32(crc, data, uInt(size));
+        unsigned char footer[4];
+        put_u32(footer, crc);
+        file.write(reinterpret_cast<const char*>(header), 8);
+        file.write(reinterpret_cast<const char*>(data), std::streamsize(size));
+        file.write(reinterpret_cast<const char*>(footer), 4);
+    }
+    void deflate_into_chunks(int flush) {
+        do {
+            stream.next_out = buffer.data();
+            stream.avail_out = uInt(buffer.size());
+            deflate(&stream, flush);
+            size_t produced = buffer.size() - stream.avail_out;
+            if (produced > 0) chunk("IDAT", buffer.data(), produced);
+        } while (stream.avail_out == 0);
+    }
+public:
+    PngWriter(const std::string& path, unsigned width, unsigned height) :
+            file(path, std::ios::binary), row(size_t(width) * 3 + 1), width(width), height(height) {
+        deflateInit(&stream, Z_DEFAULT_COMPRESSION);
+        const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+        std::array<unsigned char, 13> header{};
+        put_u32(header.data(), width);
+        put_u32(header.data() + 4, height);
+        header[8] = 8;   // Bits per channel
+        header[9] = 2;   // RGB
+        chunk("IHDR", header.data(), header.size());
+    }
+    PngWriter(const PngWriter&) = delete;
+    PngWriter& operator=(const PngWriter&) = delete;
+    ~PngWriter() {
+        deflateEnd(&stream);
+    }
+    [[nodiscard]] bool good() const {
+        return file.good();
+    }
+    // Takes width * 3 bytes of RGB, rows from top to bottom
+    void write_row(const unsigned char* rgb) {
+        if (rows == height) return;
+        row[0] = 0;  // No filter
+        std::memcpy(row.data() + 1, rgb, size_t(width) * 3);
+        stream.next_in = row.data();
+        stream.avail_in = uInt(row.size());
+        deflate_into_chunks(Z_NO_FLUSH);
+        rows++;
+    }
+    void finish() {
+        std::vector<unsigned char> blank(size_t(width) * 3);
+        while (rows < height) write_row(blank.data());
+        stream.next_in = nullptr;
+        stream.avail_in = 0;
+        deflate_into_chunks(Z_FINISH);
+        chunk("IEND", nullptr, 0);
+        file.flush();
+    }
+};